@@ -92,6 +92,9 @@ typedef uint8_t rx_buffer_index_t;
 
 class HardwareSerial : public Stream
 {
+  public:
+    // Called from the RX interrupt with each received byte, which is then not stored in the RX buffer.
+    typedef void (*rx_hook_t)(unsigned char);
   protected:
     volatile uint8_t * const _ubrrh;
     volatile uint8_t * const _ubrrl;
@@ -106,6 +109,8 @@ class HardwareSerial : public Stream
     volatile rx_buffer_index_t _rx_buffer_tail;
     volatile tx_buffer_index_t _tx_buffer_head;
     volatile tx_buffer_index_t _tx_buffer_tail;
+    // Always present so that the layout does not depend on SERIAL_RX_HOOK, only the core's ISR does.
+    volatile rx_hook_t _rx_hook;
 
     // Don't put any members after these buffers, since only the first
     // 32 bytes of this struct can be accessed quickly using the ldd
@@ -131,14 +136,23 @@ class HardwareSerial : public Stream
     inline size_t write(long n) { return write((uint8_t)n); }
     inline size_t write(unsigned int n) { return write((uint8_t)n); }
     inline size_t write(int n) { return write((uint8_t)n); }
-    using Print::write; // pull in write(str) and write(buf, size) from Print
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write; // pull in write(str) from Print
+    // Read up to size bytes that have already been received, without waiting. Returns the number read.
+    size_t readAvailable(uint8_t *buffer, size_t size);
     operator bool() { return true; }
+    // Set or clear (with NULL) a hook that takes received bytes directly from the RX interrupt. Returns false if the core was built
+    // without SERIAL_RX_HOOK, so the hook would never be called & bytes are still read as usual.
+    bool setRxHook(rx_hook_t hook);
 
     // Interrupt handlers - Not intended to be called externally
     inline void _rx_complete_irq(void);
     void _tx_udr_empty_irq(void);
 };
 
+// HardwareSerial has readAvailable() & a buffer write that copies into the TX buffer.
+#define HAVE_HWSERIAL_READ_AVAILABLE
+
 #if defined(UBRRH) || defined(UBRR0H)
   extern HardwareSerial Serial;
   #define HAVE_HWSERIAL0
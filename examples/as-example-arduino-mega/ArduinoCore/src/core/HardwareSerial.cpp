@@ -84,6 +84,13 @@ void serialEventRun(void)
 #define TX_BUFFER_ATOMIC
 #endif
 
+// likewise for the RX buffer indices, which are read & written outside the ISR by readAvailable()
+#if (SERIAL_RX_BUFFER_SIZE>256)
+#define RX_BUFFER_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+#define RX_BUFFER_ATOMIC
+#endif
+
 // Actual interrupt handlers //////////////////////////////////////////////////////////////
 
 void HardwareSerial::_tx_udr_empty_irq(void)
@@ -189,6 +196,45 @@ int HardwareSerial::read(void)
   }
 }
 
+size_t HardwareSerial::readAvailable(uint8_t *buffer, size_t size)
+{
+  rx_buffer_index_t head;
+  RX_BUFFER_ATOMIC {
+    head = _rx_buffer_head;
+  }
+  // The ISR only writes at the head, so the bytes up to it can be copied
+  // out without blocking it, then the tail is moved in one go.
+  rx_buffer_index_t tail = _rx_buffer_tail;
+  size_t n = 0;
+  while (tail != head && n < size) {
+    size_t chunk = (head > tail) ? (size_t)(head - tail) : (size_t)(SERIAL_RX_BUFFER_SIZE - tail);
+    if (chunk > size - n)
+      chunk = size - n;
+    memcpy(buffer + n, &_rx_buffer[tail], chunk);
+    n += chunk;
+    tail = (rx_buffer_index_t)(tail + chunk);
+    if (tail == SERIAL_RX_BUFFER_SIZE)
+      tail = 0;
+  }
+  RX_BUFFER_ATOMIC {
+    _rx_buffer_tail = tail;
+  }
+  return n;
+}
+
+bool HardwareSerial::setRxHook(rx_hook_t hook)
+{
+  // The pointer is two bytes, so the ISR must not see it half written.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _rx_hook = hook;
+  }
+#ifdef SERIAL_RX_HOOK
+  return true;
+#else
+  return false;
+#endif
+}
+
 int HardwareSerial::availableForWrite(void)
 {
   tx_buffer_index_t head;
@@ -278,4 +324,51 @@ size_t HardwareSerial::write(uint8_t c)
   return 1;
 }
 
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = size;
+
+  // The first byte may be able to go straight to the data register.
+  if (n > 0 && _tx_buffer_head == _tx_buffer_tail && bit_is_set(*_ucsra, UDRE0)) {
+    HardwareSerial::write(*buffer++);
+    n -= 1;
+  }
+  _written = true;
+
+  while (n > 0) {
+    tx_buffer_index_t head = _tx_buffer_head;
+    tx_buffer_index_t tail;
+    TX_BUFFER_ATOMIC {
+      tail = _tx_buffer_tail;
+    }
+
+    // Room up to the end of the buffer, always leaving one free slot
+    // before the tail.
+    size_t room = (head >= tail) ? (size_t)(SERIAL_TX_BUFFER_SIZE - head - (tail == 0)) : (size_t)(tail - head - 1);
+    if (room == 0) {
+      // Buffer full, wait as write(uint8_t) does.
+      if (bit_is_clear(SREG, SREG_I) && bit_is_set(*_ucsra, UDRE0))
+        _tx_udr_empty_irq();
+      continue;
+    }
+    if (room > n)
+      room = n;
+
+    memcpy(&_tx_buffer[head], buffer, room);
+    buffer += room;
+    n -= room;
+    head = (tx_buffer_index_t)(head + room);
+    if (head == SERIAL_TX_BUFFER_SIZE)
+      head = 0;
+
+    // One atomic section per copied run, as in write(uint8_t).
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      _tx_buffer_head = head;
+      sbi(*_ucsrb, UDRIE0);
+    }
+  }
+
+  return size;
+}
+
 #endif // whole file
@@ -6,5 +6,6 @@
 // If CONSOLE_USE_LOCAL_CONFIG  is defined then the include path must include this directory, so console.cpp can include console-locals.h. 
 
 //#include "console-unit-tests.ino"
+//#include "print-benchmark.ino"
 #include "console-example.ino"
 
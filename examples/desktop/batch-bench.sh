@@ -0,0 +1,12 @@
+#!/bin/bash
+# Run the batch runner on a generated corpus with 1, 2, 4 & 8 threads, and show the speed-up over one thread.
+
+# Make relative paths work when called from another dir. 
+scriptdir="$(dirname "$0")"
+cd "$scriptdir"
+
+SCRIPTS=${SCRIPTS:-20000}
+echo "$(nproc) cores."
+for j in 1 2 4 8; do
+	./batch -q -g $SCRIPTS -j $j 2>&1 || exit 1
+done | awk '{ print } / scripts\/s/ { for (i = 1; i < NF; i++) if ($(i+1) == "scripts/s,") r = $i; if (!base) base = r; printf("  speed-up %.2f\n", r / base) }'
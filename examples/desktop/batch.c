@@ -0,0 +1,279 @@
+/* Batch runner, runs many independent console scripts on a pool of threads, each with its own console. Scripts are dealt out in contiguous
+	runs, a thread that runs out steals half of the remaining run of another. Output is collected per script and printed in input order once all
+	have run, so it is the same for any number of threads. Throughput & per-script latency are printed on stderr. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "console.h"
+
+#ifndef CONSOLE_MULTI_CONTEXT
+#error The batch runner needs CONSOLE_MULTI_CONTEXT
+#endif
+
+#define BATCH_MAX_THREADS 64
+#define BATCH_GENERATED_LINES 20				// Lines in each generated script.
+
+typedef struct {
+	const char* name;
+	char* text;									// Script, split into lines in place as it is run.
+	size_t len;
+	char* out;									// Output, grown as needed.
+	size_t out_len, out_size;
+	uint64_t ns;								// Time to run.
+	uint32_t lines, errors;
+} script_t;
+
+// Each worker owns a run of scripts, it takes from the front & thieves take from the back.
+typedef struct {
+	pthread_mutex_t lock;
+	size_t lo, hi;
+	console_t con;
+	pthread_t thread;
+	uint32_t id, steals;
+} worker_t;
+
+static script_t* f_scripts;
+static size_t f_nscripts;
+static worker_t f_workers[BATCH_MAX_THREADS];
+static unsigned f_nworkers;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void* xrealloc(void* p, size_t n) {
+	p = realloc(p, n);
+	if (NULL == p) {
+		perror("realloc");
+		exit(1);
+	}
+	return p;
+}
+
+// Output from the current console goes to the script it is running.
+void console_output_write(const char* buf, size_t n) {
+	script_t* const sc = (script_t*)consoleGetContext()->user;
+	if (NULL == sc)
+		return;
+	if (sc->out_len + n > sc->out_size) {
+		sc->out_size = (sc->out_size + n) * 2;
+		sc->out = (char*)xrealloc(sc->out, sc->out_size);
+	}
+	memcpy(&sc->out[sc->out_len], buf, n);
+	sc->out_len += n;
+}
+static void print_str(const char* s) { consolePrint(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, console_ptr_arg(s)); }
+
+// Run a script from a fresh console, each line is echoed with its output like the desktop example.
+static void run_script(worker_t* w, script_t* sc) {
+	const uint64_t start = now_ns();
+	w->con.user = sc;
+	consoleInit();
+	char* line = sc->text;
+	char* const end = &sc->text[sc->len];
+	while (line < end) {
+		char* nl = (char*)memchr(line, '\n', (size_t)(end - line));
+		if (NULL == nl)
+			nl = end;
+		*nl = '\0';
+
+		const char* cmd = "??";
+		consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(line));
+		print_str(" -> ");
+		const console_rc_t rc = consoleProcess(line, &cmd);
+		sc->lines += 1;
+		if (CONSOLE_RC_ERR_USER == rc) {			// EXIT ends the script.
+			print_str("Bye...");
+			consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+			break;
+		}
+		if (CONSOLE_RC_OK != rc) {					// Error in command `<cmd>': <description> (<code>)
+			sc->errors += 1;
+			print_str("Error in command `");
+			consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(cmd));
+			print_str("': ");
+			print_str(consoleGetErrorDescription(rc));
+			print_str(" (");
+			consolePrint(CONSOLE_PRINT_SIGNED|CONSOLE_PRINT_NO_SEP, rc);
+			print_str(")");
+		}
+		consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+		line = nl + 1;
+	}
+	consoleOutputFlush();
+	w->con.user = NULL;
+	sc->ns = now_ns() - start;
+}
+
+// Take the next script from our own run, returns false if it is empty.
+static bool take(worker_t* w, size_t* idx) {
+	pthread_mutex_lock(&w->lock);
+	const bool ok = (w->lo < w->hi);
+	if (ok)
+		*idx = w->lo++;
+	pthread_mutex_unlock(&w->lock);
+	return ok;
+}
+
+// Steal half the remaining run of the first other worker that has any, returns false if all are empty. No new work arrives so we are then done.
+static bool steal(worker_t* w) {
+	for (unsigned i = 1; i < f_nworkers; i += 1) {
+		worker_t* const victim = &f_workers[(w->id + i) % f_nworkers];
+		pthread_mutex_lock(&victim->lock);
+		const size_t n = victim->hi - victim->lo;
+		size_t lo = 0, hi = 0;
+		if (n > 0) {
+			hi = victim->hi;
+			lo = hi - (n + 1) / 2;
+			victim->hi = lo;
+		}
+		pthread_mutex_unlock(&victim->lock);
+		if (n > 0) {
+			pthread_mutex_lock(&w->lock);
+			w->lo = lo;
+			w->hi = hi;
+			pthread_mutex_unlock(&w->lock);
+			w->steals += 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void* worker(void* arg) {
+	worker_t* const w = (worker_t*)arg;
+	consoleInitContext(&w->con, NULL);				// Current console for this thread.
+	do {
+		size_t idx;
+		while (take(w, &idx))
+			run_script(w, &f_scripts[idx]);
+	} while (steal(w));
+	return NULL;
+}
+
+static char* read_file(const char* fn, size_t* len) {
+	FILE* const fp = fopen(fn, "rb");
+	if (NULL == fp)
+		return NULL;
+	char* text = NULL;
+	size_t n = 0, size = 0;
+	while (1) {
+		if (n == size)
+			text = (char*)xrealloc(text, size = size * 2 + 4096);
+		const size_t nr = fread(&text[n], 1, size - n, fp);
+		if (0 == nr)
+			break;
+		n += nr;
+	}
+	fclose(fp);
+	*len = n;
+	return text;
+}
+
+// A script of simple arithmetic that varies with its index, with an occasional error.
+static char* generate_script(size_t i, size_t* len) {
+	char* const text = (char*)xrealloc(NULL, BATCH_GENERATED_LINES * 40);
+	size_t n = 0;
+	for (unsigned l = 0; l < BATCH_GENERATED_LINES; l += 1)
+		n += (size_t)sprintf(&text[n], (0 == (i + l) % 97) ? "%zu %u /\n" : "%zu %u + 3 * . 1 U.\n", i, (0 == (i + l) % 97) ? 0 : l);
+	*len = n;
+	return text;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+	const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+	unsigned nthreads = 1;
+	size_t ngenerate = 0;
+	bool quiet = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "j:g:q")) != -1) {
+		switch (opt) {
+			case 'j': nthreads = (unsigned)atoi(optarg); break;
+			case 'g': ngenerate = (size_t)atol(optarg); break;
+			case 'q': quiet = true; break;
+			default: fprintf(stderr, "Usage: %s [-j threads] [-q] [-g count | script-file...]\n", argv[0]); return 1;
+		}
+	}
+	if ((nthreads < 1) || (nthreads > BATCH_MAX_THREADS)) {
+		fprintf(stderr, "Threads must be 1 to %u.\n", BATCH_MAX_THREADS);
+		return 1;
+	}
+
+	// Load all scripts before starting the clock.
+	f_nscripts = ngenerate ? ngenerate : (size_t)(argc - optind);
+	f_scripts = (script_t*)calloc(f_nscripts ? f_nscripts : 1, sizeof(script_t));
+	for (size_t i = 0; i < f_nscripts; i += 1) {
+		script_t* const sc = &f_scripts[i];
+		if (ngenerate) {
+			sc->name = "generated";
+			sc->text = generate_script(i, &sc->len);
+		}
+		else {
+			sc->name = argv[optind + (int)i];
+			sc->text = read_file(sc->name, &sc->len);
+			if (NULL == sc->text) {
+				perror(sc->name);
+				return 1;
+			}
+		}
+	}
+
+	// Deal out contiguous runs & start the workers.
+	f_nworkers = nthreads;
+	const uint64_t start = now_ns();
+	for (unsigned i = 0; i < f_nworkers; i += 1) {
+		worker_t* const w = &f_workers[i];
+		pthread_mutex_init(&w->lock, NULL);
+		w->lo = f_nscripts * i / f_nworkers;
+		w->hi = f_nscripts * (i + 1) / f_nworkers;
+		w->id = i;
+		w->steals = 0;
+	}
+	for (unsigned i = 0; i < f_nworkers; i += 1) {
+		if (0 != pthread_create(&f_workers[i].thread, NULL, worker, &f_workers[i])) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	unsigned steals = 0;
+	for (unsigned i = 0; i < f_nworkers; i += 1) {
+		pthread_join(f_workers[i].thread, NULL);
+		steals += f_workers[i].steals;
+	}
+	const double elapsed = (double)(now_ns() - start) / 1e9;
+
+	// Results in input order.
+	uint64_t lines = 0, errors = 0;
+	uint64_t* const lat = (uint64_t*)xrealloc(NULL, (f_nscripts ? f_nscripts : 1) * sizeof(uint64_t));
+	for (size_t i = 0; i < f_nscripts; i += 1) {
+		const script_t* const sc = &f_scripts[i];
+		if (!quiet) {
+			printf("== %s\n", sc->name);
+			fwrite(sc->out, 1, sc->out_len, stdout);
+		}
+		lines += sc->lines;
+		errors += sc->errors;
+		lat[i] = sc->ns;
+	}
+	if (f_nscripts > 0) {
+		qsort(lat, f_nscripts, sizeof(*lat), cmp_u64);
+		fprintf(stderr, "threads %2u: %zu scripts, %llu lines, %llu errors in %.3fs, %.0f scripts/s, %.0f lines/s, "
+		  "script latency p50 %.1fus p99 %.1fus, %u steals\n", nthreads, f_nscripts, (unsigned long long)lines, (unsigned long long)errors,
+		  elapsed, (double)f_nscripts / elapsed, (double)lines / elapsed, (double)lat[f_nscripts / 2] / 1e3,
+		  (double)lat[(f_nscripts * 99) / 100] / 1e3, steals);
+	}
+	return 0;
+}
@@ -0,0 +1,13 @@
+// User commands for the desktop console & the console server.
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "console.h"
+
+bool console_cmds_user(char* cmd) {
+	switch (console_hash(cmd)) {
+		case /** 2+ (x1 - x2) Add 2 to TOS. **/ 0x685c: console_u_tos() += 2; break;
+		default: return false;
+	}
+	return true;
+}
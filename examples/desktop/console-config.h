@@ -6,6 +6,21 @@
 // Need for printf()
 #include <stdio.h>
 
+// Output is buffered and written to stdout with a single write for each line.
+#include <stddef.h>
+#define CONSOLE_OUTPUT_BUFFER_SIZE 80
+void console_output_write(const char* buf, size_t n);
+#define CONSOLE_OUTPUT_WRITE console_output_write
+
+// Strings are decoded into a scratch arena, and may be kept for later lines.
+#define CONSOLE_SCRATCH_SIZE CONSOLE_INPUT_BUFFER_SIZE
+#define CONSOLE_STRING_HEAP_SIZE 128
+
+// Background tasks, run from the main loop while waiting for input.
+#define CONSOLE_TASKS 4
+#define CONSOLE_TASK_LINE_SIZE 32
+#define CONSOLE_TASK_STACK_SIZE 4
+
 // We want example commands for trying out functionality.
 #define CONSOLE_WANT_EXAMPLE_COMMANDS
 
@@ -0,0 +1,153 @@
+/* Load test for the console server. Opens a number of sessions, each sends a line & waits for the prompt that ends the reply before sending the
+	next. Reports lines per second over all sessions, and the median & 99th percentile time from sending a line to reading its prompt. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define LOADTEST_LINE "1 2 + .\n"
+#define LOADTEST_MAX_EVENTS 256
+
+typedef struct {
+	uint64_t sent_ns;					// When the pending line was sent, zero while waiting for the signon prompt.
+	int fd;
+	int ready;							// Signon prompt seen.
+} client_t;
+
+// Latencies in ns, grown as needed.
+static uint64_t* f_lat;
+static size_t f_nlat, f_lat_size;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void record(uint64_t ns) {
+	if (f_nlat == f_lat_size) {
+		f_lat_size = f_lat_size ? (f_lat_size * 2) : 4096;
+		f_lat = (uint64_t*)realloc(f_lat, f_lat_size * sizeof(*f_lat));
+		if (NULL == f_lat) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	f_lat[f_nlat++] = ns;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+	const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static int connect_to(const char* path, int port) {
+	int fd;
+	if (path) {
+		struct sockaddr_un un = { .sun_family = AF_UNIX };
+		strncpy(un.sun_path, path, sizeof(un.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+		if ((fd >= 0) && (connect(fd, (const struct sockaddr*)&un, sizeof(un)) < 0)) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	else {
+		struct sockaddr_in in = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+		fd = socket(AF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+		if ((fd >= 0) && (connect(fd, (const struct sockaddr*)&in, sizeof(in)) < 0)) {
+			close(fd);
+			fd = -1;
+		}
+		const int one = 1;
+		if (fd >= 0)
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	return fd;
+}
+
+static bool send_line(client_t* c) {
+	c->sent_ns = now_ns();
+	return write(c->fd, LOADTEST_LINE, sizeof(LOADTEST_LINE) - 1) == (ssize_t)(sizeof(LOADTEST_LINE) - 1);
+}
+
+int main(int argc, char **argv) {
+	const char* path = NULL;
+	int port = 5555;
+	unsigned nsessions = 1;
+	double seconds = 2.0;
+	int opt;
+	while ((opt = getopt(argc, argv, "u:p:n:d:")) != -1) {
+		switch (opt) {
+			case 'u': path = optarg; break;
+			case 'p': port = atoi(optarg); break;
+			case 'n': nsessions = (unsigned)atoi(optarg); break;
+			case 'd': seconds = atof(optarg); break;
+			default: fprintf(stderr, "Usage: %s [-u unix-socket-path | -p tcp-port] [-n sessions] [-d seconds]\n", argv[0]); return 1;
+		}
+	}
+
+	const int ep = epoll_create1(EPOLL_CLOEXEC);
+	client_t* const clients = (client_t*)calloc(nsessions, sizeof(client_t));
+	if ((ep < 0) || (NULL == clients)) {
+		perror("setup");
+		return 1;
+	}
+	for (unsigned i = 0; i < nsessions; i += 1) {
+		clients[i].fd = connect_to(path, port);
+		if (clients[i].fd < 0) {
+			perror("connect");
+			return 1;
+		}
+		struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &clients[i] };
+		epoll_ctl(ep, EPOLL_CTL_ADD, clients[i].fd, &ev);
+	}
+
+	// Each prompt ends a reply. The first is the signon, after that each one ends the reply to the pending line.
+	const uint64_t start = now_ns();
+	const uint64_t end = start + (uint64_t)(seconds * 1e9);
+	uint64_t t;
+	while ((t = now_ns()) < end) {
+		struct epoll_event events[LOADTEST_MAX_EVENTS];
+		const int n = epoll_wait(ep, events, LOADTEST_MAX_EVENTS, 100);
+		for (int i = 0; i < n; i += 1) {
+			client_t* const c = (client_t*)events[i].data.ptr;
+			char buf[4096];
+			const ssize_t nr = read(c->fd, buf, sizeof(buf));
+			if (nr <= 0) {
+				fprintf(stderr, "Session closed by server.\n");
+				return 1;
+			}
+			if (NULL == memchr(buf, '>', (size_t)nr))
+				continue;
+			if (c->ready)
+				record(now_ns() - c->sent_ns);
+			c->ready = 1;
+			if (!send_line(c)) {
+				perror("write");
+				return 1;
+			}
+		}
+	}
+	const double elapsed = (double)(t - start) / 1e9;
+
+	if (0 == f_nlat) {
+		fprintf(stderr, "No replies.\n");
+		return 1;
+	}
+	qsort(f_lat, f_nlat, sizeof(*f_lat), cmp_u64);
+	printf("%s sessions %5u: %9.0f lines/s, latency p50 %8.1fus, p99 %8.1fus\n", path ? "unix" : "tcp ", nsessions, (double)f_nlat / elapsed,
+	  (double)f_lat[f_nlat / 2] / 1e3, (double)f_lat[(f_nlat * 99) / 100] / 1e3);
+	return 0;
+}
@@ -0,0 +1,20 @@
+#!/bin/bash
+# Run the load test against the console server over both Unix domain & TCP sockets, with 1, 100 & 1000 sessions.
+
+# Make relative paths work when called from another dir. 
+scriptdir="$(dirname "$0")"
+cd "$scriptdir"
+
+SOCK=/tmp/console-loadtest.sock
+PORT=5556
+SECONDS_PER_RUN=${SECONDS_PER_RUN:-2}
+
+./server -u $SOCK -p $PORT > /dev/null &
+server=$!
+trap 'kill $server 2>/dev/null' EXIT
+sleep 0.2
+
+for n in 1 100 1000; do
+	./loadtest -u $SOCK -n $n -d $SECONDS_PER_RUN || exit 1
+	./loadtest -p $PORT -n $n -d $SECONDS_PER_RUN || exit 1
+done
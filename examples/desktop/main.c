@@ -5,20 +5,26 @@
 
 #include "console.h"
 
-bool console_cmds_user(char* cmd) {
-	switch (console_hash(cmd)) {
-		case /** 2+ (x1 - x2) Add 2 to TOS. **/ 0x685c: console_u_tos() += 2; break;
-		default: return false;
-	}
-	return true;
-}
-
-static void prompt(void) { fputs("\n> ", stdout); }
-static void seperator(void) { fputs(" -> ", stdout); }
-
 // Linux requires this to emulate TurboC getch(). Copied from Stackoverflow
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+// All output goes through the console's buffer, so it is written to stdout in one go.
+void console_output_write(const char* buf, size_t n) {
+	while (n > 0) {
+		const ssize_t nw = write(STDOUT_FILENO, buf, n);
+		if (nw <= 0)
+			break;
+		buf += nw;
+		n -= (size_t)nw;
+	}
+}
+static void print_str(const char* s) { consolePrint(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, console_ptr_arg(s)); }
+
+static void prompt(void) { consolePrint(CONSOLE_PRINT_NEWLINE, 0); print_str("> "); consoleOutputFlush(); }
+static void seperator(void) { print_str(" -> "); }
 
 /* reads from keypress, doesn't echo */
 static int getch(void) {
@@ -33,29 +39,64 @@ static int getch(void) {
     return ch;
 }
 
+static uint32_t now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U);
+}
+
+// Run background tasks until there is input, their output is followed by a new prompt.
+static void wait_for_input(void) {
+	while (1) {
+		const uint32_t wait = consoleTasksWait(now_ms());
+		if (0 == wait) {
+			if (consoleServiceTasks(now_ms()) > 0) {
+				print_str("> ");
+				consoleOutputFlush();
+			}
+			continue;
+		}
+		struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+		if (0 != poll(&pfd, 1, (CONSOLE_TASKS_IDLE == wait) ? -1 : (int)wait))
+			return;
+	}
+}
+
 int main(int argc, char **argv) {
 	(void)argc; (void)argv;
 	consoleInit();							// Setup console.
-	printf("\n\n" 
+	setvbuf(stdin, NULL, _IONBF, 0);		// So that poll() sees all input not yet read.
+	print_str("\n\n"
 	      "FConsole Example -- `exit' to quit.");
 	prompt();
 
 	while (1) {
+		wait_for_input();
 		const char c = (char)getch();
-		if (CONSOLE_INPUT_NEWLINE_CHAR != c)			// Don't echo newline.
-			putchar(c);
+		if (CONSOLE_INPUT_NEWLINE_CHAR != c) {			// Don't echo newline.
+			consolePrint(CONSOLE_PRINT_CHAR|CONSOLE_PRINT_NO_SEP, c);
+			consoleOutputFlush();
+		}
 		console_rc_t rc = consoleAccept(c);				// Add it to the input buffer.
 		if (rc >= CONSOLE_RC_OK) {						// On newline...
 			const char* cmd = "??";						// Last command on error.
 			seperator(); 								// Seperator string for output.
+			consoleTasksWait(now_ms());					// Tasks added by the line are scheduled from now.
 			if (CONSOLE_RC_OK == rc)					// Only process if no error from accept...
 				rc = consoleProcess(consoleAcceptBuffer(), &cmd);	// Process input and record new error code.
 			if (CONSOLE_RC_OK != rc) {					// If all went well then we get an OK status code.
 				if (CONSOLE_RC_ERR_USER == rc) {		// Exit error code.
-					puts("Bye...");
+					print_str("Bye...");
+					consolePrint(CONSOLE_PRINT_NEWLINE, 0);
 					break;
 				}
-				printf("Error in command `%s': %s (%d)", cmd , consoleGetErrorDescription(rc), rc);
+				print_str("Error in command `");		// Error in command `<cmd>': <description> (<code>)
+				consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(cmd));
+				print_str("': ");
+				print_str(consoleGetErrorDescription(rc));
+				print_str(" (");
+				consolePrint(CONSOLE_PRINT_SIGNED|CONSOLE_PRINT_NO_SEP, rc);
+				print_str(")");
 			}
 			prompt();							// In any case print a newline and prompt ready for the next line of input.
 		}
@@ -4,4 +4,4 @@
 scriptdir="$(dirname "$0")"
 cd "$scriptdir"
 
-../../src/console-mk.py main.c ../../src/console.c
+../../src/console-mk.py commands.c ../../src/console.c
@@ -0,0 +1,283 @@
+/* Console server, serving many sessions over a Unix domain socket & loopback TCP, each with its own console. Used to simulate many devices.
+	All sockets are non-blocking and run from a single epoll loop. Output from each session's console is queued in a ring buffer, which is written
+	with writev() once all the input read has been run, or when the socket can take more. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "console.h"
+
+#ifndef CONSOLE_MULTI_CONTEXT
+#error The server needs CONSOLE_MULTI_CONTEXT
+#endif
+
+#define SERVER_DEFAULT_PATH "/tmp/console-server.sock"
+#define SERVER_DEFAULT_PORT 5555
+#define SERVER_OUT_SIZE 16384			// Output queued for a session, if it fills the session is closed.
+#define SERVER_READ_SIZE 512			// Input read per event, so that one busy session cannot hog the loop.
+#define SERVER_MAX_EVENTS 256
+
+// Listening sockets & sessions are both endpoints, so that epoll can point at either.
+enum { EP_LISTEN, EP_SESSION };
+typedef struct {
+	int fd;
+	int kind;
+} endpoint_t;
+
+typedef struct {
+	console_t con;						// First so that its alignment is the struct's.
+	endpoint_t ep;
+	uint32_t events;					// Events currently registered with epoll.
+	uint32_t closing;					// Close once output is written, set by EXIT or on output overflow.
+	uint32_t out_tail, out_count;		// Ring buffer of output.
+	char out[SERVER_OUT_SIZE];
+} session_t;
+
+static int f_epoll;
+static volatile sig_atomic_t f_stop;
+static unsigned f_nsessions;
+
+// Output from the current console is queued on its session.
+void console_output_write(const char* buf, size_t n) {
+	session_t* const s = (session_t*)consoleGetContext()->user;
+	if (NULL == s)						// Not in a session, should not happen.
+		return;
+	if (n > SERVER_OUT_SIZE - s->out_count) {	// No room, give up on this session.
+		s->closing = true;
+		return;
+	}
+	uint32_t head = (s->out_tail + s->out_count) % SERVER_OUT_SIZE;
+	s->out_count += (uint32_t)n;
+	while (n > 0) {
+		size_t chunk = SERVER_OUT_SIZE - head;
+		if (chunk > n)
+			chunk = n;
+		memcpy(&s->out[head], buf, chunk);
+		buf += chunk;
+		n -= chunk;
+		head = 0;
+	}
+}
+static void print_str(const char* s) { consolePrint(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, console_ptr_arg(s)); }
+static void prompt(void) { consolePrint(CONSOLE_PRINT_NEWLINE, 0); print_str("> "); consoleOutputFlush(); }
+
+// Register interest in input while there is room for the output it makes, and in output while there is some queued.
+static void session_update_events(session_t* s) {
+	uint32_t events = 0;
+	if (!s->closing && (s->out_count < SERVER_OUT_SIZE / 2))
+		events |= EPOLLIN;
+	if (s->out_count > 0)
+		events |= EPOLLOUT;
+	if (events != s->events) {
+		struct epoll_event ev = { .events = events, .data.ptr = &s->ep };
+		epoll_ctl(f_epoll, EPOLL_CTL_MOD, s->ep.fd, &ev);
+		s->events = events;
+	}
+}
+
+static void session_close(session_t* s) {
+	epoll_ctl(f_epoll, EPOLL_CTL_DEL, s->ep.fd, NULL);
+	close(s->ep.fd);
+	free(s);
+	f_nsessions -= 1;
+}
+
+// Write as much queued output as the socket will take in one writev(), returns false if the session has gone.
+static bool session_flush(session_t* s) {
+	while (s->out_count > 0) {
+		struct iovec iov[2];
+		int niov = 1;
+		const uint32_t first = SERVER_OUT_SIZE - s->out_tail;
+		iov[0].iov_base = &s->out[s->out_tail];
+		iov[0].iov_len = (s->out_count < first) ? s->out_count : first;
+		if (s->out_count > first) {		// Wrapped.
+			iov[1].iov_base = s->out;
+			iov[1].iov_len = s->out_count - first;
+			niov = 2;
+		}
+		const ssize_t nw = writev(s->ep.fd, iov, niov);
+		if (nw < 0) {
+			if (EAGAIN == errno)
+				break;
+			if (EINTR == errno)
+				continue;
+			return false;
+		}
+		s->out_tail = (uint32_t)((s->out_tail + (size_t)nw) % SERVER_OUT_SIZE);
+		s->out_count -= (uint32_t)nw;
+	}
+	return !(s->closing && (0 == s->out_count));
+}
+
+static void run_line(session_t* s, console_rc_t rc) {
+	const char* cmd = "??";						// Last command on error.
+	if (CONSOLE_RC_OK == rc)					// Only process if no error from accept...
+		rc = consoleProcess(consoleAcceptBuffer(), &cmd);
+	if (CONSOLE_RC_ERR_USER == rc) {			// Exit error code.
+		print_str("Bye...");
+		consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+		s->closing = true;
+		return;
+	}
+	if (CONSOLE_RC_OK != rc) {					// Error in command `<cmd>': <description> (<code>)
+		print_str("Error in command `");
+		consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(cmd));
+		print_str("': ");
+		print_str(consoleGetErrorDescription(rc));
+		print_str(" (");
+		consolePrint(CONSOLE_PRINT_SIGNED|CONSOLE_PRINT_NO_SEP, rc);
+		print_str(")");
+	}
+	prompt();
+}
+
+// Run all lines in one read from the session, returns false if it has gone.
+static bool session_read(session_t* s) {
+	char buf[SERVER_READ_SIZE];
+	const ssize_t nr = read(s->ep.fd, buf, sizeof(buf));
+	if (0 == nr)
+		return false;
+	if (nr < 0)
+		return (EAGAIN == errno) || (EINTR == errno);
+
+	consoleSetContext(&s->con);
+	for (ssize_t i = 0; (i < nr) && !s->closing; i += 1) {
+		const console_rc_t rc = consoleAccept(buf[i]);
+		if (rc >= CONSOLE_RC_OK)
+			run_line(s, rc);
+	}
+	return true;
+}
+
+static void session_open(int fd) {
+	session_t* const s = (session_t*)malloc(sizeof(session_t));
+	if (NULL == s) {
+		close(fd);
+		return;
+	}
+	s->ep.fd = fd;
+	s->ep.kind = EP_SESSION;
+	s->events = EPOLLIN;
+	s->closing = false;
+	s->out_tail = s->out_count = 0;
+	struct epoll_event ev = { .events = s->events, .data.ptr = &s->ep };
+	if (epoll_ctl(f_epoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		close(fd);
+		free(s);
+		return;
+	}
+	f_nsessions += 1;
+
+	consoleInitContext(&s->con, s);			// Sets the current console.
+	print_str("Console Server -- `exit' to quit.");
+	prompt();
+	if (session_flush(s))
+		session_update_events(s);
+	else
+		session_close(s);
+}
+
+static void accept_all(endpoint_t* ep) {
+	while (1) {
+		const int fd = accept4(ep->fd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+		if (fd < 0)
+			break;								// EAGAIN when there are no more, anything else is not fatal to the server.
+		const int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));	// Fails harmlessly on a Unix socket.
+		session_open(fd);
+	}
+}
+
+static bool listen_on(endpoint_t* ep, int domain, const struct sockaddr* addr, socklen_t len) {
+	ep->kind = EP_LISTEN;
+	ep->fd = socket(domain, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+	if (ep->fd < 0)
+		return false;
+	const int one = 1;
+	setsockopt(ep->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = ep };
+	if ((bind(ep->fd, addr, len) < 0) || (listen(ep->fd, SOMAXCONN) < 0) || (epoll_ctl(f_epoll, EPOLL_CTL_ADD, ep->fd, &ev) < 0)) {
+		close(ep->fd);
+		return false;
+	}
+	return true;
+}
+
+static void on_signal(int sig) { (void)sig; f_stop = 1; }
+
+int main(int argc, char **argv) {
+	const char* path = SERVER_DEFAULT_PATH;
+	int port = SERVER_DEFAULT_PORT;
+	int opt;
+	while ((opt = getopt(argc, argv, "u:p:")) != -1) {
+		switch (opt) {
+			case 'u': path = optarg; break;
+			case 'p': port = atoi(optarg); break;
+			default: fprintf(stderr, "Usage: %s [-u unix-socket-path] [-p tcp-port]\n", argv[0]); return 1;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	f_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (f_epoll < 0) {
+		perror("epoll_create1");
+		return 1;
+	}
+
+	static endpoint_t listeners[2];
+	struct sockaddr_un un = { .sun_family = AF_UNIX };
+	strncpy(un.sun_path, path, sizeof(un.sun_path) - 1);
+	unlink(path);
+	if (!listen_on(&listeners[0], AF_UNIX, (const struct sockaddr*)&un, sizeof(un))) {
+		perror(path);
+		return 1;
+	}
+	struct sockaddr_in in = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+	if (!listen_on(&listeners[1], AF_INET, (const struct sockaddr*)&in, sizeof(in))) {
+		perror("tcp");
+		return 1;
+	}
+	printf("Console server on %s & 127.0.0.1:%d\n", path, port);
+	fflush(stdout);
+
+	while (!f_stop) {
+		struct epoll_event events[SERVER_MAX_EVENTS];
+		const int n = epoll_wait(f_epoll, events, SERVER_MAX_EVENTS, -1);
+		for (int i = 0; i < n; i += 1) {
+			endpoint_t* const ep = (endpoint_t*)events[i].data.ptr;
+			if (EP_LISTEN == ep->kind) {
+				accept_all(ep);
+				continue;
+			}
+			session_t* const s = (session_t*)((char*)ep - offsetof(session_t, ep));
+			bool ok = true;
+			if (events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR))
+				ok = session_read(s);
+			if (ok)
+				ok = session_flush(s);
+			if (ok)
+				session_update_events(s);
+			else
+				session_close(s);
+		}
+	}
+
+	printf("Stopped with %u sessions.\n", f_nsessions);
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,85 @@
+/* Cycle benchmark for consolePrint() number formatting on an ATmega2560 (Mega) at 16MHz.
+	Compares the old method of one Print call per leading zero/lead char/digits/separator against consolePrint(), which formats into a
+	buffer & writes with a single call. Output goes to a null stream so that only formatting & write overhead is measured, the results
+	are printed on Serial. Timer1 runs with no prescaler so TCNT1 counts CPU cycles, each measured call must take less than 65536 cycles. */
+#include <Arduino.h>
+
+#include "console.h"
+#include "FConsole.h"
+
+// Stream that discards output, counting calls to write and bytes written.
+class NullStream : public Stream {
+public:
+	NullStream() : calls(0), bytes(0) {}
+	virtual size_t write(uint8_t) { calls += 1; bytes += 1; return 1; }
+	virtual size_t write(const uint8_t*, size_t n) { calls += 1; bytes += n; return n; }
+	virtual int available() { return 0; }
+	virtual int read() { return -1; }
+	virtual int peek() { return -1; }
+	uint32_t calls, bytes;
+};
+static NullStream null_stream;
+
+// The old Arduino consolePrint() number output, kept here for comparison.
+static void print_old(Print& s, uint_least8_t opt, console_arg_t x) {
+	switch (opt & ~(CONSOLE_PRINT_NO_SEP|CONSOLE_PRINT_NO_LEAD)) {
+		case CONSOLE_PRINT_SIGNED:		s.print((console_int_t)x, DEC); break;
+		case CONSOLE_PRINT_UNSIGNED:	if (!(opt & CONSOLE_PRINT_NO_LEAD)) s.print('+');
+										s.print((console_uint_t)x, DEC); break;
+		case CONSOLE_PRINT_HEX:			if (!(opt & CONSOLE_PRINT_NO_LEAD)) s.print('$');
+										for (console_uint_t m = 0xf; CONSOLE_UINT_MAX != m; m = (m << 4) | 0xf) {
+											if ((console_uint_t)x <= m)
+												s.print(0);
+										}
+										s.print((console_uint_t)x, HEX); break;
+	}
+	if (!(opt & CONSOLE_PRINT_NO_SEP))	s.print(' ');
+}
+
+static const console_int_t VALUES[] PROGMEM = { 0, 1, 9, 10, 99, 100, 1234, 9999, 10000, -1, CONSOLE_INT_MIN, CONSOLE_INT_MAX, 0x1f, 0x7ff };
+#define N_VALUES (sizeof(VALUES) / sizeof(VALUES[0]))
+
+static uint32_t f_cycles;
+static uint16_t f_start;
+static inline void timer_start() { f_start = TCNT1; }
+static inline void timer_stop() { f_cycles += (uint16_t)(TCNT1 - f_start); }
+
+static void report(const __FlashStringHelper* name) {
+	Serial.print(name);
+	Serial.print(F(": cycles/value "));
+	Serial.print(f_cycles / N_VALUES);
+	Serial.print(F(", writes/value "));
+	Serial.print((float)null_stream.calls / N_VALUES);
+	Serial.print(F(", bytes "));
+	Serial.println(null_stream.bytes);
+	f_cycles = 0;
+	null_stream.calls = null_stream.bytes = 0;
+}
+
+static void bench(uint_least8_t opt, const __FlashStringHelper* name) {
+	Serial.println(name);
+	for (uint8_t i = 0; i < N_VALUES; i += 1) {
+		console_int_t x; memcpy_P(&x, &VALUES[i], sizeof(x));
+		timer_start(); print_old(null_stream, opt, x); timer_stop();
+	}
+	report(F("  print()     "));
+	for (uint8_t i = 0; i < N_VALUES; i += 1) {
+		console_int_t x; memcpy_P(&x, &VALUES[i], sizeof(x));
+		timer_start(); consolePrint(opt, x); consoleOutputFlush(); timer_stop();	// Flush in case output is buffered.
+	}
+	report(F("  consolePrint"));
+}
+
+void setup() {
+	Serial.begin(115200);
+	FConsole.begin(NULL, null_stream);
+	TCCR1A = 0; TCCR1B = _BV(CS10);			// Timer1 normal mode, clock/1.
+
+	Serial.println(F("\nconsolePrint() benchmark"));
+	bench(CONSOLE_PRINT_SIGNED, F("SIGNED"));
+	bench(CONSOLE_PRINT_UNSIGNED, F("UNSIGNED"));
+	bench(CONSOLE_PRINT_HEX, F("HEX"));
+	bench(CONSOLE_PRINT_HEX|CONSOLE_PRINT_NO_SEP|CONSOLE_PRINT_NO_LEAD, F("HEX NO_SEP NO_LEAD"));
+}
+
+void loop() {}
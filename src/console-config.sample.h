@@ -32,25 +32,38 @@
  #define CONSOLE_PRINTF_FMT_PSTR "s"
 #endif
 
-/* Our little language only works with one integral type, which is usally it is the natural int for the part. 
-	Define to allow different types for this type. 
-	Types console_int_t must be a signed type, console_uint_t must be unsigned, and they must both be the same size. 
-	Also note that the type must be able to represent a pointer. */
+/* Our little language only works with one integral type, the cell, which is usually the natural int for the part. 
+	Define CONSOLE_CELL_SIZE as 2, 4 or 8 to set the width of a cell in bytes, the default is the width of a pointer. 
+	Types console_int_t must be a signed type, console_uint_t must be unsigned, and they must both be CONSOLE_CELL_SIZE bytes. 
+	A cell need not be able to represent a pointer. If it cannot then addresses are pushed as handles, see CONSOLE_ADDRESS_TABLE_SIZE. */
 #include <stdint.h>
-#if   defined(__SIZEOF_POINTER__) && (__SIZEOF_POINTER__ == 2)
+#include <limits.h>
+#ifndef CONSOLE_CELL_SIZE
+ #if defined(__SIZEOF_POINTER__)
+  #define CONSOLE_CELL_SIZE __SIZEOF_POINTER__
+ #elif UINT_MAX == 0xffffU
+  #define CONSOLE_CELL_SIZE 2
+ #else
+  #define CONSOLE_CELL_SIZE 4
+ #endif
+#endif
+#if CONSOLE_CELL_SIZE == 2
  typedef int16_t	console_int_t;
  typedef uint16_t  console_uint_t;
-#elif defined(__SIZEOF_POINTER__) && (__SIZEOF_POINTER__ == 4)
+#elif CONSOLE_CELL_SIZE == 4
  typedef int32_t	console_int_t;
  typedef uint32_t  console_uint_t;
-#elif defined(__SIZEOF_POINTER__) && (__SIZEOF_POINTER__ == 8)
+#elif CONSOLE_CELL_SIZE == 8
  typedef int64_t	console_int_t;
  typedef uint64_t  console_uint_t;
 #else
- typedef int      console_int_t;
- typedef unsigned console_uint_t;
+ #error "CONSOLE_CELL_SIZE must be 2, 4 or 8."
 #endif
 
+/* Number of addresses that can be pushed on a single line if a cell cannot hold a pointer, e.g. 32 bit cells on a 64 bit host. 
+	Ignored if a cell can hold a pointer. */
+#define CONSOLE_ADDRESS_TABLE_SIZE 8
+
 /* For efficient implementation we have a small signed & unsigned type. Usually [u]int8_t will work fine. */
 typedef uint8_t console_small_uint_t;
 typedef int8_t  console_small_int_t;
@@ -62,15 +75,97 @@ typedef int8_t  console_small_int_t;
 // #define CONSOLE_DEFINE_PRINT_ARDUINO
 // #define CONSOLE_ARDUINO_STREAM
 
-// Since nearly every platform will have a printf available the following symbol is defined to be a printf-like function or macro. 
+/* Numbers are formatted by a small built-in formatter. If CONSOLE_USE_PRINTF is defined they are formatted with printf as before, which is 
+	bigger & slower, and on AVR links in vfprintf. */
+// #define CONSOLE_USE_PRINTF
+
+/* Since nearly every platform will have a printf available the following symbol is defined to be a printf-like function or macro. It is used
+	if CONSOLE_USE_PRINTF is defined without an output buffer, and to write output if CONSOLE_OUTPUT_WRITE is not defined. */
 #define CONSOLE_PRINTF printf 
 
-// Might need long format modifier for integer types.
-#include <limits.h>
-#if INTPTR_MAX > INT_MAX
- #define CONSOLE_PRINTF_FMT_MOD "l"
+/* If defined output from consolePrint() is formatted into a buffer of this size, which is written in one go with CONSOLE_OUTPUT_WRITE() when a 
+	newline is printed, when it is full, or when consoleOutputFlush() is called. It must be big enough for the longest number. 
+	FConsole also uses this for its own buffer, which it writes to its stream. */
+// #define CONSOLE_OUTPUT_BUFFER_SIZE 80
+
+/* If defined there may be many consoles, each in a console_t, see consoleInitContext(). The current console is held in a variable with storage 
+	class CONSOLE_THREAD_LOCAL, so each thread can run its own. If not defined there is a single static console, with no overhead. */
+// #define CONSOLE_MULTI_CONTEXT
+#if defined(AVR)
+ #define CONSOLE_THREAD_LOCAL
+#else
+ #define CONSOLE_THREAD_LOCAL _Thread_local
+#endif
+
+/* If defined input may be fed a char at a time from an interrupt with consoleAcceptIsr() into a pair of line buffers. FConsole does this from the
+	HardwareSerial RX interrupt if the core is built with SERIAL_RX_HOOK defined, see HardwareSerial::setRxHook(). Build the core & the sketch with
+	the same setting, if only the sketch has it setRxHook() returns false & FConsole reads input as usual. Binary frames are decoded in the ISR too.
+	With CONSOLE_MULTI_CONTEXT every console_t holds its own pair of buffers. */
+// #define CONSOLE_ACCEPT_DOUBLE_BUFFER
+
+/* If defined console_queue_t is a lock-free byte queue of this size, for one producer & one consumer, e.g. a reader thread or ISR feeding input to 
+	consoleServiceQueue() on the thread that runs the console, or the console writing output for another thread. It holds one less than its size. 
+	On AVR keep it to 256 or less so that the indices are single bytes and are read & written atomically. */
+// #define CONSOLE_QUEUE_SIZE 128
+
+/* FConsole::service() accepts at most this many input chars per call, and returns early after running a line. If 
+	CONSOLE_SERVICE_TIME_BUDGET_US is defined it also returns once it has run for that many microseconds. */
+// #define CONSOLE_SERVICE_BYTE_BUDGET 32
+// #define CONSOLE_SERVICE_TIME_BUDGET_US 200
+
+/* If defined a line may be run a few commands at a time with consoleProcessBegin() & consoleProcessStep(). FConsole::service() then runs at most
+	CONSOLE_SERVICE_TOKEN_BUDGET commands of a line per call, fewer if the time budget is spent, and takes no more input from that stream until 
+	the line is done. A long running command may also do some work & return with console_yield() to be called again on the next step. */
+// #define CONSOLE_PROCESS_STEP
+// #define CONSOLE_SERVICE_TOKEN_BUDGET 8
+
+/* If defined a round-robin multitasker runs up to this many scripts at once, each in its own console with its own stack. Each call of 
+	consoleMultitaskRun() runs the next task until it gives way at PAUSE or at the end of a line. Needs CONSOLE_MULTI_CONTEXT & 
+	CONSOLE_PROCESS_STEP. */
+// #define CONSOLE_MULTITASK 2
+
+/* If defined FConsole output is queued in a ring buffer of this size, and written from service() only as far as the stream's 
+	availableForWrite() allows, so printing never waits on the UART. HardwareSerial implements availableForWrite(). A stream that does not, found
+	by it having no room when it is added, is written with write() as soon as output is queued, which may block as it would without the queue. */
+// #define CONSOLE_TX_QUEUE_SIZE 128
+
+/* What FConsole does when the TX queue is full: CONSOLE_TX_QUEUE_BLOCK waits for the stream as before, CONSOLE_TX_QUEUE_DROP discards output,
+	CONSOLE_TX_QUEUE_TRUNCATE discards the rest of the line and writes CONSOLE_TX_QUEUE_MARKER instead. */
+// #define CONSOLE_TX_QUEUE_POLICY CONSOLE_TX_QUEUE_TRUNCATE
+// #define CONSOLE_TX_QUEUE_MARKER "~"
+
+/* FConsole can serve this many streams, added with FConsole.addStream(), each with its own console, output & input. They are serviced in
+	turn by FConsole.service() & output from a line goes to the stream it came from. More than one needs CONSOLE_MULTI_CONTEXT. */
+// #define CONSOLE_FCONSOLE_STREAMS 2
+
+/* If defined `1 MACHINE' puts an FConsole stream in machine mode for automated hosts. There is no echo or prompt, the host starts each line 
+	with a sequence number and the reply is the sequence number, the output, then `=' & the numeric status on one line, e.g. `17 3 =0'. So a 
+	host can send many lines without waiting & match the replies. `0 MACHINE' goes back. The line that switches either way is answered with the 
+	status in machine format, after the echo going in & followed by the prompt going out. */
+// #define CONSOLE_MACHINE_MODE
+
+/* If defined, instead of an output buffer, output is staged in the part of the line passed to consoleProcess() that has already been run, and 
+	written when that is full, on a newline, and when consoleProcess() returns. Without a scratch arena output stops short of the first string 
+	decoded into the line. Output outside consoleProcess() is written directly. Needs CONSOLE_DEFINE_PRINT, so FConsole does not support it. */
+// #define CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+
+// Function or macro to write a buffer of output, called as CONSOLE_OUTPUT_WRITE(const char* buf, size_t n).
+// #define CONSOLE_OUTPUT_WRITE(buf_, n_) fwrite((buf_), 1, (n_), stdout)
+
+// With CONSOLE_USE_PRINTF and an output buffer numbers are formatted with a vsnprintf-like function, taking a format made by CONSOLE_PSTR().
+#if defined(AVR)
+ #define CONSOLE_VSNPRINTF vsnprintf_P
 #else
+ #define CONSOLE_VSNPRINTF vsnprintf
+#endif
+
+// Might need long format modifier for the cell type.
+#if (CONSOLE_CELL_SIZE == 2) || ((CONSOLE_CELL_SIZE == 4) && (INT_MAX >= 2147483647))
  #define CONSOLE_PRINTF_FMT_MOD ""
+#elif (CONSOLE_CELL_SIZE == 8) && (LONG_MAX == 2147483647L)
+ #define CONSOLE_PRINTF_FMT_MOD "ll"
+#else
+ #define CONSOLE_PRINTF_FMT_MOD "l"
 #endif
 
 // Stack size, we don't need much.
@@ -79,12 +174,54 @@ typedef int8_t  console_small_int_t;
 // Input buffer size
 #define CONSOLE_INPUT_BUFFER_SIZE 40
 
+/* Size of a scratch arena that string literals are decoded into, rather than back into the input buffer. It is reset by each call of 
+	consoleProcess(). If not defined strings are decoded in place in the input buffer. */
+// #define CONSOLE_SCRATCH_SIZE 40
+
+/* Size of a heap for strings that must outlive the line they were entered on, they are copied with KEEP. Only KEEP-CLEAR or consoleInit() 
+	free the heap. If not defined there is no heap. */
+// #define CONSOLE_STRING_HEAP_SIZE 64
+
+/* If defined the console has this many background tasks, each a line of less than CONSOLE_TASK_LINE_SIZE chars that EVERY or AFTER run 
+	periodically or once after a delay in ms. Each task has its own stack of CONSOLE_TASK_STACK_SIZE items, kept between runs. The application
+	calls consoleServiceTasks() with the time in ms from its main loop, FConsole::service() does this between lines. */
+// #define CONSOLE_TASKS 4
+// #define CONSOLE_TASK_LINE_SIZE 24
+// #define CONSOLE_TASK_STACK_SIZE 2
+
 // Character to signal EOL for input string.
 #define CONSOLE_INPUT_NEWLINE_CHAR '\r'
 
 // Character to cancel current line. If not defined line cancel not implemented. 
 #define CONSOLE_INPUT_CANCEL_CHAR '\\'
 
+/* Character to stop a running line, it is raised as the error ABORTED before the next command, or when a command polls for it. FConsole looks for
+	it in the input while a line runs, and in the RX interrupt with SERIAL_RX_HOOK. If not defined lines cannot be aborted. */
+// #define CONSOLE_INPUT_ABORT_CHAR '\x03'
+
+/* If defined a line that starts with this char is a binary frame instead, for automated hosts, that runs one command given by its hash with 
+	arguments & results as binary cells, so nothing is parsed or formatted. See consoleProcessFrame(). Text lines work as before. */
+// #define CONSOLE_BINARY_FRAME_CHAR '\x02'
+
+/* If defined binary frames carry a sequence number & a CRC-16, so that a frame corrupted on the link is not run, & the host resends it. The CRC 
+	table is 512 bytes of PROGMEM. CONSOLE_FRAME_REPLAY is the number of replies kept, so that a frame sent again because its reply was lost is not
+	run twice. It is only taken as sent again if both its sequence number & CRC match. */
+// #define CONSOLE_FRAME_CRC
+// #define CONSOLE_FRAME_REPLAY 4
+
+/* If defined `u UPLOAD' takes the next u bytes of input raw & passes them to a sink set by consoleSetBulkSink() a buffer full at a time, 
+	printing this char when ready & after each so that the host knows to send more. So a large table is sent as itself, not as hex strings. */
+// #define CONSOLE_BULK_ACK_CHAR '\x06'
+
+/* With CONSOLE_ACCEPT_DOUBLE_BUFFER the size of each upload chunk, at most 255, the double buffers grow to it if it is larger than the input 
+	buffer. The host waits for an ack after each chunk, so a larger one comes closer to the line rate for twice the extra RAM. The default is 
+	CONSOLE_INPUT_BUFFER_SIZE. */
+// #define CONSOLE_BULK_CHUNK_SIZE 255
+
+/* If defined `a u DUMP' prints u bytes from address a as lines of the address & 16 hex bytes, each printed in one go, & DUMP-B writes them raw, 
+	so that a buffer is read back in one command. DUMP-P & DUMP-PB read PROGMEM. */
+// #define CONSOLE_WANT_DUMP
+
 // String for output newline.
 #define CONSOLE_OUTPUT_NEWLINE_STR "\n"
 
@@ -94,7 +231,7 @@ typedef int8_t  console_small_int_t;
 // Example commands used for testing & tryout.
 // #define CONSOLE_WANT_EXAMPLE_COMMANDS
 
-// User recogniser functions, may be multiple, separated by commas. Needs final comma.
+// User recogniser functions, may be multiple, separated by commas. Needs final comma. With FConsole use `fconsole_cmds_user,'.
 #define CONSOLE_USER_RECOGNISERS
 
 // We want some help included. 
@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <setjmp.h>
 
 #include "console.h"
@@ -20,34 +23,72 @@ STATIC_ASSERT(sizeof(console_int_t) == sizeof(console_uint_t));
 STATIC_ASSERT(utilsIsTypeSigned(console_int_t));
 STATIC_ASSERT(!utilsIsTypeSigned(console_uint_t));
 
-// The console type must be able to represent a pointer.
-STATIC_ASSERT(sizeof(void*) == sizeof(console_uint_t));
+STATIC_ASSERT(sizeof(console_uint_t) == CONSOLE_CELL_SIZE);
+
+// The console type must be able to represent a pointer, unless addresses are held as handles.
+#ifndef CONSOLE_ADDRESS_HANDLES
+STATIC_ASSERT(sizeof(void*) <= sizeof(console_uint_t));
+#endif
 
 #pragma GCC diagnostic pop
 
 // Unused static functions are OK. The linker will remove them.
 // #pragma GCC diagnostic ignored "-Wunused-function"
 
-// Struct to hold the console interpreter's state.
-typedef struct {
-	console_int_t dstack[CONSOLE_DATA_STACK_SIZE];	// Our stack, grows down in memory.
-	console_int_t* sp;								// Stack pointer, points to topmost item.
-	jmp_buf jmpbuf;									// How we do aborts.
-} console_context_t;
-
+// The console's state, either a single static instance or the current one of many.
+#ifdef CONSOLE_MULTI_CONTEXT
+static console_t f_console_default = {
+#if defined(CONSOLE_HAVE_OUTPUT_CONTEXT) && defined(CONSOLE_OUTPUT_BUFFER_SIZE)
+	.output = { f_console_default.output.buf, f_console_default.output.buf, &f_console_default.output.buf[CONSOLE_OUTPUT_BUFFER_SIZE], { 0 } },
+#endif
+};
+static CONSOLE_THREAD_LOCAL console_t* f_console_current = &f_console_default;
+#define CTX (f_console_current->ctx)
+#define ACCEPT_CTX (f_console_current->accept)
+#define ACCEPT_DOUBLE_CTX (f_console_current->accept_double)
+#define OUTPUT_CTX (f_console_current->output)
+#else
 static console_context_t f_console_ctx;
+#define CTX f_console_ctx
+#define ACCEPT_CTX f_accept_context
+#define ACCEPT_DOUBLE_CTX f_accept_double_context
+#define OUTPUT_CTX f_output_context
+#endif
+
+#if defined(CONSOLE_OUTPUT_SHARE_INPUT_BUFFER) && !defined(CONSOLE_SCRATCH_SIZE)
+#define output_pin(s_) do { if (NULL == CTX.pin) CTX.pin = (char*)(s_); } while (0)
+#else
+#define output_pin(s_) (void)0
+#endif
 
 // Stack fills from top down.
-#define CONSOLE_STACKBASE (&f_console_ctx.dstack[CONSOLE_DATA_STACK_SIZE])
+#define CONSOLE_STACKBASE (&CTX.dstack[CONSOLE_DATA_STACK_SIZE])
 
 // Predicates for push & pop.
-#define console_can_pop(n_) (f_console_ctx.sp < (CONSOLE_STACKBASE - (n_) + 1))
-#define console_can_push(n_) (f_console_ctx.sp >= &f_console_ctx.dstack[0 + (n_)])
+#define console_can_pop(n_) (CTX.sp < (CONSOLE_STACKBASE - (n_) + 1))
+#define console_can_push(n_) (CTX.sp >= &CTX.dstack[0 + (n_)])
 
 // Call on error, thanks to the magic of longjmp() it will return to the last setjmp with the error code.
 void console_raise(console_rc_t rc) {
-	longjmp(f_console_ctx.jmpbuf, rc);
+	longjmp(CTX.jmpbuf, rc);
+}
+
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+void console_poll_abort(void) {
+	if (CTX.abort_req) {
+		CTX.abort_req = false;
+		console_raise(CONSOLE_RC_ERR_ABORTED);
+	}
 }
+#endif
+
+#ifdef CONSOLE_PROCESS_STEP
+void console_yield(console_int_t state) {
+	CTX.yield_state = state;
+	console_raise(CONSOLE_RC_STAT_YIELD);
+}
+console_int_t console_yield_state(void) { return CTX.yield_state; }
+#endif
 
 // Error handling in commands.
 void console_verify_can_pop(console_small_uint_t n) { if (!console_can_pop(n)) console_raise(CONSOLE_RC_ERR_DSTK_UNF); }
@@ -55,20 +96,93 @@ void console_verify_can_push(console_small_uint_t n) { if (!console_can_push(n))
 void console_verify_bounds(console_small_uint_t idx, console_small_uint_t size) { if (idx >= size) console_raise(CONSOLE_RC_ERR_BAD_IDX); }
 
 // Stack primitives.
-console_int_t console_u_get(console_small_uint_t i)	{ console_verify_bounds(i, console_u_depth()); return f_console_ctx.sp[i]; }
-console_int_t* console_u_tos_(void) 		{ console_verify_can_pop(1); return f_console_ctx.sp; }
-console_int_t* console_u_nos_(void)			{ console_verify_can_pop(2); return f_console_ctx.sp + 1; }
-console_small_uint_t console_u_depth(void)	{ return (console_small_uint_t)(CONSOLE_STACKBASE - f_console_ctx.sp); }
-console_int_t console_u_pop(void) 			{ console_verify_can_pop(1); return *(f_console_ctx.sp++); }
-void console_u_push(console_int_t x) 		{ console_verify_can_push(1); *--f_console_ctx.sp = x; }
-void console_u_clear(void)					{ f_console_ctx.sp = CONSOLE_STACKBASE; }
+console_int_t console_u_get(console_small_uint_t i)	{ console_verify_bounds(i, console_u_depth()); return CTX.sp[i]; }
+console_int_t* console_u_tos_(void) 		{ console_verify_can_pop(1); return CTX.sp; }
+console_int_t* console_u_nos_(void)			{ console_verify_can_pop(2); return CTX.sp + 1; }
+console_small_uint_t console_u_depth(void)	{ return (console_small_uint_t)(CONSOLE_STACKBASE - CTX.sp); }
+console_int_t console_u_pop(void) 			{ console_verify_can_pop(1); return *(CTX.sp++); }
+void console_u_push(console_int_t x) 		{ console_verify_can_push(1); *--CTX.sp = x; }
+void console_u_clear(void)					{ CTX.sp = CONSOLE_STACKBASE; }
+
+#ifdef CONSOLE_ADDRESS_HANDLES
+// Handles are only required to be valid for the current line, so the table is cleared by consoleProcess(). Zero is reserved for NULL.
+static void address_clear(void) { CTX.ap = &CTX.addrs[0]; }
+
+console_int_t console_ptr_to_cell(const void* p) {
+	if (NULL == p)
+		return 0;
+#ifdef CONSOLE_STRING_HEAP_SIZE
+	if (((const char*)p >= &CTX.heap[0]) && ((const char*)p < &CTX.heap[CONSOLE_STRING_HEAP_SIZE]))
+		return (console_int_t)-((const char*)p - &CTX.heap[0] + 1);		// Heap addresses are negative so they outlive the line.
+#endif
+
+	const void** a = &CTX.addrs[0];
+	while (a < CTX.ap) {					// Reuse the handle if the address has already been seen.
+		if (*a++ == p)
+			return (console_int_t)(a - &CTX.addrs[0]);
+	}
+	if (CTX.ap >= &CTX.addrs[CONSOLE_ADDRESS_TABLE_SIZE])
+		console_raise(CONSOLE_RC_ERR_ADDR_OVF);
+	*CTX.ap++ = p;
+	return (console_int_t)(CTX.ap - &CTX.addrs[0]);
+}
+void* console_cell_to_ptr(console_int_t x) {
+	if (0 == x)
+		return NULL;
+#ifdef CONSOLE_STRING_HEAP_SIZE
+	if (x < 0) {
+		if ((console_uint_t)-(x + 1) >= (console_uint_t)(CTX.heap_p - &CTX.heap[0]))
+			console_raise(CONSOLE_RC_ERR_BAD_IDX);
+		return &CTX.heap[-(x + 1)];
+	}
+#endif
+	if ((console_uint_t)x > (console_uint_t)(CTX.ap - &CTX.addrs[0]))
+		console_raise(CONSOLE_RC_ERR_BAD_IDX);
+	return (void*)CTX.addrs[x - 1];
+}
+#endif
+
+#ifdef CONSOLE_SCRATCH_SIZE
+static void scratch_clear(void) { CTX.scratch_p = &CTX.scratch[0]; }
+
+void* console_scratch_alloc(size_t n) {
+	if (n > (size_t)(&CTX.scratch[CONSOLE_SCRATCH_SIZE] - CTX.scratch_p))
+		console_raise(CONSOLE_RC_ERR_MEM_OVF);
+	void* p = CTX.scratch_p;
+	CTX.scratch_p += n;
+	return p;
+}
+#endif
+
+#ifdef CONSOLE_STRING_HEAP_SIZE
+static void heap_clear(void) { CTX.heap_p = &CTX.heap[0]; }
+
+void* console_keep(const void* p, size_t n) {
+	if (n > (size_t)(&CTX.heap[CONSOLE_STRING_HEAP_SIZE] - CTX.heap_p))
+		console_raise(CONSOLE_RC_ERR_MEM_OVF);
+	void* k = memcpy(CTX.heap_p, p, n);
+	CTX.heap_p += n;
+	return k;
+}
+#endif
+
+#ifdef CONSOLE_FRAME_REPLAY
+static void replay_clear(void) { memset(CTX.replay, 0, sizeof(CTX.replay)); CTX.replay_next = 0; }
+#endif
 
 // Hash function as we store command names as a 16 bit hash. Lower case letters are converted to upper case.
 // The values came from Wikipedia and seem to work well, in that collisions between the hash values of different commands are very rare.
 // All characters in the string are hashed even non-printable ones.
 #define HASH_START (5381)
 #define HASH_MULT (33)
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+static char f_frame_cmd[] = "\x7f";			// Name given to the recognisers for the command in a frame, which has its hash already.
+#endif
 uint16_t console_hash(const char* str) {
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	if (f_frame_cmd == str)
+		return CTX.frame_hash;
+#endif
 	uint16_t h = HASH_START;
 	char c;
 	while ('\0' != (c = *str++)) {
@@ -106,7 +220,7 @@ static bool convert_number(console_uint_t* number, console_small_uint_t base, co
 		// We need the non-zero test to catch the case of all 1's in accumulator with an extra 'f' in hex.
 		// This was not getting caught.
 		const console_uint_t old_number = *number;
-		*number = *number * base + digit;
+		*number = (console_uint_t)(*number * base + digit);
 		if ((old_number > (console_uint_t)0U) && (old_number >= *number))
 			console_raise(CONSOLE_RC_ERR_NUM_OVF);
 	}
@@ -186,7 +300,12 @@ bool console_r_string(char* cmd) {
 		return false;
 
 	const char *rp = &cmd[1];		// Start reading from first char past the leading '"'.
-	char *wp = &cmd[0];				// Write output string back into input buffer.
+#ifdef CONSOLE_SCRATCH_SIZE
+	char* const str = (char*)console_scratch_alloc(strlen(cmd));	// Escapes only shorten the string, and the '"' leaves room for the nul.
+#else
+	char* const str = &cmd[0];		// Write output string back into input buffer.
+#endif
+	char *wp = str;
 
 	while ('\0' != *rp) {			// Iterate over all chars...
 		if ('\\' != *rp)			// Just copy all chars, the input routine makes sure that they are all printable. But
@@ -208,8 +327,12 @@ bool console_r_string(char* cmd) {
 		wp += 1;
 		rp += 1;
 	}
-exit:	*wp = '\0';									// Terminate string in input buffer.
-	console_u_push((console_int_t)&cmd[0]);   		// Push address we started writing at.
+exit:	*wp = '\0';									// Terminate string.
+#ifdef CONSOLE_SCRATCH_SIZE
+	CTX.scratch_p = wp + 1;				// Give back what we did not use.
+#endif
+	output_pin(str);								// String may be in the input line.
+	console_u_push_ptr(str);   						// Push address we started writing at.
 	return true;
 }
 
@@ -220,18 +343,29 @@ bool console_r_hex_string(char* cmd) {
 	if ('&' != *cmd++)
 		return false;
 
-	unsigned char* out_ptr = (unsigned char*)cmd; 	// We write the converted number back into the input buffer.
+#ifdef CONSOLE_SCRATCH_SIZE
+	char* const mark = CTX.scratch_p;			// So we can give back the memory on error.
+	len_ptr = (unsigned char*)console_scratch_alloc(strlen(cmd) / 2 + 1);
+#endif
+	unsigned char* out_ptr = len_ptr + 1; 				// We write the converted number after the length.
 	while ('\0' != *cmd) {
 		if (!convert_2_hex(cmd, out_ptr))			// Do conversion.
-			return false;							// Bail on error;
+			goto error;								// Bail on error;
 		cmd += 2;
 		out_ptr += 1;
 	}
 	*len_ptr = (unsigned char)(out_ptr - len_ptr) - 1; 		// Store length, looks odd, using len as a pointer and a value.
 	if (0 == *len_ptr)
-		return false;									// Zero length string is an error.
-	console_u_push((console_int_t)len_ptr);				// Push _address_.
+		goto error;										// Zero length string is an error.
+	output_pin(len_ptr);								// String may be in the input line.
+	console_u_push_ptr(len_ptr);						// Push _address_.
 	return true;
+
+error:
+#ifdef CONSOLE_SCRATCH_SIZE
+	CTX.scratch_p = mark;
+#endif
+	return false;
 }
 
 // Essential commands that will always be required
@@ -240,11 +374,14 @@ bool console_cmds_builtin(char* cmd) {
 		case /** . (d - ) Pop and print as signed decimal. **/ 0xb58b: consolePrint(CONSOLE_PRINT_SIGNED, console_u_pop()); break;
 		case /** U. (u - ) Pop and print as unsigned decimal, with leading `+'. **/ 0x73de: consolePrint(CONSOLE_PRINT_UNSIGNED, console_u_pop()); break;
 		case /** $. (u - ) Pop and print as 4 hex digits with leading `$'. **/ 0x658f: consolePrint(CONSOLE_PRINT_HEX, console_u_pop()); break;
-		case /** ." (s - ) Pop and print string. **/ 0x66c9: consolePrint(CONSOLE_PRINT_STR, console_u_pop()); break;
+		case /** ." (s - ) Pop and print string. **/ 0x66c9: consolePrint(CONSOLE_PRINT_STR, console_ptr_arg(console_u_pop_ptr())); break;
 		case /** DEPTH ( - u) Push stack depth. **/ 0xb508: console_u_push(console_u_depth()); break;
 		case /** CLEAR ( ... - <empty>) Remove all items from stack. **/ 0x9f9c: console_u_clear(); break;
 		case /** DROP (x - ) Remove top item from stack. **/ 0x5c2c: console_u_pop(); break;
-		case /** HASH (s - u) Pop string and push hash value. **/ 0x90b7: { console_u_tos() = console_hash((const char*)console_u_tos()); } break;
+		case /** HASH (s - u) Pop string and push hash value. **/ 0x90b7: { console_u_tos() = (console_int_t)console_hash((const char*)console_cell_to_ptr(console_u_tos())); } break;
+#ifdef CONSOLE_PROCESS_STEP
+		case /** PAUSE ( - ) Give way to other work, returns from consoleProcessStep(). **/ 0xddf7: if (0 == console_yield_state()) console_yield(1); break;
+#endif
 		default: return false;
 	}
 	return true;
@@ -266,12 +403,30 @@ bool console_cmds_example(char* cmd) {
 			console_u_tos() = (console_int_t)((console_uint_t)console_u_tos() / rhs);
 		} break;
 		case /** NEGATE (d1 - d2) Negate signed value: d2 = -d1. **/ 0x7a79: console_unop(-); break;
+#ifdef CONSOLE_PROCESS_STEP
+		case /** COUNTDOWN (u - ) Print u down to 1, yielding after each. **/ 0x7f74: {
+			console_int_t n = console_yield_state();	// Count left, zero on the first call.
+			if (0 == n)
+				n = console_u_pop();
+			if (n > 0) {
+				consolePrint(CONSOLE_PRINT_SIGNED, n);
+				if (n > 1)
+					console_yield(n - 1);
+			}
+		} break;
+#endif
 		case /** # ( - ) Comment, rest of input ignored. **/ 0xb586: console_raise(CONSOLE_RC_STAT_IGN_EOL); break;
 		case /** RAISE (i - ) Raise value as exception. **/ 0x4069: console_raise((console_rc_t)console_u_pop()); break;
 		case /** EXIT ( - ?) Exit console. **/ 0xc745: console_raise(CONSOLE_RC_ERR_USER); break;	// Custom exception.
 		case /** PICK (u - x) Copy stack item by index. **/ 0x13b4: console_u_tos() = console_u_get((console_small_uint_t)console_u_tos()+1); break;
 		case /** OVER (x1 x2 - x1 x2 x1) Copy second stack item. **/ 0x398b: console_u_push(console_u_nos()); break;
-		case /** PRINT (x i - ) Call consolePrint(i, x). **/ 0x47b4: { uint8_t opt = (uint8_t)console_u_pop(); consolePrint(opt, console_u_pop()); } break;
+		case /** PRINT (x i - ) Call consolePrint(i, x). **/ 0x47b4: {
+			const uint8_t opt = (uint8_t)console_u_pop();
+			switch (opt & ~(CONSOLE_PRINT_NO_LEAD|CONSOLE_PRINT_NO_SEP)) {	// Strings are addresses, which might be handles.
+				case CONSOLE_PRINT_STR: case CONSOLE_PRINT_STR_P: consolePrint(opt, console_ptr_arg(console_u_pop_ptr())); break;
+				default: consolePrint(opt, console_u_pop()); break;
+			}
+		} break;
 		default: return false;
 	}
 	return true;
@@ -288,7 +443,7 @@ bool console_cmds_help(char* cmd) {
 			const char* const * hh = &help_cmds[0];
 			for (console_small_uint_t i = 0; i < sizeof(help_cmds)/sizeof(help_cmds[0]); i += 1, hh += 1) {
 				consolePrint(CONSOLE_PRINT_NEWLINE, 0);
-				consolePrint(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, (console_int_t)CONSOLE_READ_PTR(hh));
+				consolePrint(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, console_ptr_arg(CONSOLE_READ_PTR(hh)));
 			}
 		} break;
 		case /** ?HELP ( - ) Print list of all commands. **/ 0x74cb: {
@@ -302,11 +457,11 @@ bool console_cmds_help(char* cmd) {
 			}
 		} break;
 		case /** HELP (s - ) Search for help on given command. **/ 0x7d54: {
-			const uint16_t cmd_hash = console_hash((const char*)console_u_pop());
+			const uint16_t cmd_hash = console_hash((const char*)console_u_pop_ptr());
 			const uint16_t* hh = &help_hashes[0];
 			for (console_small_uint_t i = 0; i < sizeof(help_hashes)/sizeof(help_hashes[0]); i += 1, hh += 1) {
 				if((uint16_t)CONSOLE_READ_U16(hh) == cmd_hash) {
-					consolePrint(CONSOLE_PRINT_STR_P, (console_int_t)CONSOLE_READ_PTR(&help_cmds[i]));
+					consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(CONSOLE_READ_PTR(&help_cmds[i])));
 					return true;
 				}
 			}
@@ -318,6 +473,95 @@ bool console_cmds_help(char* cmd) {
 }
 #endif // CONSOLE_WANT_HELP
 
+// Optional string heap commands.
+#ifdef CONSOLE_STRING_HEAP_SIZE
+bool console_cmds_keep(char* cmd) {
+	switch (console_hash(cmd)) {
+		case /** KEEP (s1 - s2) Copy string to heap. **/ 0x129e: {
+			const char* s = (const char*)console_cell_to_ptr(console_u_tos());
+			console_u_tos() = console_ptr_to_cell(console_keep(s, strlen(s) + 1));
+		} break;
+		case /** CKEEP (a1 - a2) Copy counted string, as from a hex string, to heap. **/ 0x1b7d: {
+			const unsigned char* s = (const unsigned char*)console_cell_to_ptr(console_u_tos());
+			console_u_tos() = console_ptr_to_cell(console_keep(s, (size_t)s[0] + 1));
+		} break;
+		case /** KEEP-CLEAR ( - ) Free all kept strings. **/ 0x942a: heap_clear(); break;
+		default: return false;
+	}
+	return true;
+}
+#endif // CONSOLE_STRING_HEAP_SIZE
+
+static bool is_whitespace(char c) { return (' ' == c) || ('\t' == c); }
+static bool is_nul(char c) { return ('\0' == c); }
+
+// Optional background task commands.
+#ifdef CONSOLE_TASKS
+static void tasks_clear(void) { memset(CTX.tasks, 0, sizeof(CTX.tasks)); CTX.task_running = NULL; }
+static bool task_is_free(const console_task_t* t) { return ('\0' == t->line[0]); }
+static bool task_is_due(const console_task_t* t, uint32_t now) { return ((int32_t)(now - t->due) >= 0); }	// Works across wrap.
+
+// Add a task for the rest of the line with the delay on the stack, pushing its id. The rest of the line is not run now.
+static void task_add(bool repeat) {
+	const uint32_t ms = (uint32_t)(console_uint_t)console_u_pop();
+	const char* line = CTX.line_rest;
+	while (is_whitespace(*line))
+		line += 1;
+	const size_t len = strlen(line);
+	if ((0 == len) || (repeat && (0 == ms)))
+		console_raise(CONSOLE_RC_ERR_BAD_IDX);
+	if (len >= CONSOLE_TASK_LINE_SIZE)
+		console_raise(CONSOLE_RC_ERR_MEM_OVF);
+
+	for (console_small_uint_t i = 0; i < CONSOLE_TASKS; i += 1) {
+		console_task_t* const t = &CTX.tasks[i];
+		if (task_is_free(t)) {
+			memcpy(t->line, line, len + 1);
+			t->due = CTX.task_now + ms;
+			t->period = repeat ? ms : 0;
+			t->depth = 0;
+			console_u_push((console_int_t)(i + 1));
+			console_raise(CONSOLE_RC_STAT_IGN_EOL);
+		}
+	}
+	console_raise(CONSOLE_RC_ERR_MEM_OVF);			// No free task.
+}
+
+// Pop a task id & return the task, which must be in use.
+static console_task_t* task_pop(void) {
+	const console_uint_t id = (console_uint_t)console_u_pop();
+	if ((id < 1) || (id > CONSOLE_TASKS) || task_is_free(&CTX.tasks[id - 1]))
+		console_raise(CONSOLE_RC_ERR_BAD_IDX);
+	return &CTX.tasks[id - 1];
+}
+
+bool console_cmds_tasks(char* cmd) {
+	switch (console_hash(cmd)) {
+		case /** EVERY (u - i) Run the rest of the line every u ms, push task id. **/ 0x86b8: task_add(true); break;
+		case /** AFTER (u - i) Run the rest of the line once after u ms, push task id. **/ 0x1341: task_add(false); break;
+		case /** TASKS ( - ) List tasks as id, period & line. **/ 0x837b: {
+			for (console_small_uint_t i = 0; i < CONSOLE_TASKS; i += 1) {
+				const console_task_t* const t = &CTX.tasks[i];
+				if (!task_is_free(t)) {
+					consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+					consolePrint(CONSOLE_PRINT_UNSIGNED|CONSOLE_PRINT_NO_LEAD, (console_arg_t)(i + 1));
+					consolePrint(CONSOLE_PRINT_UNSIGNED|CONSOLE_PRINT_NO_LEAD, (console_arg_t)t->period);
+					consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(t->line));
+				}
+			}
+		} break;
+		case /** KILL (i - ) Remove task. **/ 0x01a7: {
+			console_task_t* const t = task_pop();
+			t->line[0] = '\0';
+			if (t == CTX.task_running)				// A task may kill itself.
+				CTX.task_running = NULL;
+		} break;
+		default: return false;
+	}
+	return true;
+}
+#endif // CONSOLE_TASKS
+
 // Static list of recogniser functions. Any extra must be listed in the config header.
 /* The number & string recognisers must be before any recognisers that lookup using a hash, as numbers & strings
 	can have potentially any hash value so could look like commands. */
@@ -328,6 +572,18 @@ static const console_recogniser_func RECOGNISERS[] CONSOLE_PROGMEM = {
 	console_r_string,
 	console_r_hex_string,
 	console_cmds_builtin,
+ #ifdef CONSOLE_STRING_HEAP_SIZE
+	console_cmds_keep,
+ #endif
+ #ifdef CONSOLE_TASKS
+	console_cmds_tasks,
+ #endif
+ #ifdef CONSOLE_BULK_ACK_CHAR
+	console_cmds_bulk,
+ #endif
+ #ifdef CONSOLE_WANT_DUMP
+	console_cmds_dump,
+ #endif
  #ifdef CONSOLE_WANT_HELP
 	console_cmds_help,
  #endif
@@ -339,54 +595,313 @@ static const console_recogniser_func RECOGNISERS[] CONSOLE_PROGMEM = {
 	NULL
 };
 
+// Digits for the built-in formatter, decimal is done two digits at a time. 
+static const char DIGIT_PAIRS[] CONSOLE_PROGMEM =
+	"0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+	"5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+static const char HEX_DIGITS[] CONSOLE_PROGMEM = "0123456789ABCDEF";
+
+/* Write decimal digits backwards from end, returning a pointer to the first digit. The divide by a constant 100 is done by the compiler
+	with a multiply & shift on 32 & 64 bit targets. */
+static char* format_decimal(char* end, console_uint_t u) {
+	while (u >= 100U) {
+		const console_small_uint_t pair = (console_small_uint_t)((u % 100U) * 2U);
+		u /= 100U;
+		*--end = (char)CONSOLE_READ_BYTE(&DIGIT_PAIRS[pair + 1]);
+		*--end = (char)CONSOLE_READ_BYTE(&DIGIT_PAIRS[pair]);
+	}
+	if (u >= 10U) {
+		*--end = (char)CONSOLE_READ_BYTE(&DIGIT_PAIRS[u * 2U + 1]);
+		*--end = (char)CONSOLE_READ_BYTE(&DIGIT_PAIRS[u * 2U]);
+	}
+	else
+		*--end = (char)('0' + u);
+	return end;
+}
+
+// Write a fixed number of hex digits backwards from end, returning a pointer to the first digit.
+static char* format_hex(char* end, console_uint_t u, console_small_uint_t ndigits) {
+	do {
+		*--end = (char)CONSOLE_READ_BYTE(&HEX_DIGITS[u & 0xfU]);
+		u >>= 4;
+	} while (--ndigits > 0);
+	return end;
+}
+
+char* consoleFormatNumber(char* end, console_small_uint_t opt, console_arg_t x) {
+	char lead;
+	char* p = end;
+
+	if (!(opt & CONSOLE_PRINT_NO_SEP))
+		*--p = ' ';
+	switch (opt & ~(CONSOLE_PRINT_NO_LEAD|CONSOLE_PRINT_NO_SEP)) {
+		default:						return NULL;
+		case CONSOLE_PRINT_SIGNED:		if ((console_int_t)x < 0) {
+											p = format_decimal(p, (console_uint_t)-(console_uint_t)(console_int_t)x);
+											*--p = '-';
+										}
+										else
+											p = format_decimal(p, (console_uint_t)x);
+										return p;
+		case CONSOLE_PRINT_UNSIGNED:	p = format_decimal(p, (console_uint_t)x); lead = '+'; break;
+		case CONSOLE_PRINT_HEX:			p = format_hex(p, (console_uint_t)x, sizeof(console_uint_t) * 2); lead = '$'; break;
+		case CONSOLE_PRINT_HEX2:		p = format_hex(p, (console_uint_t)x, 2); lead = '$'; break;
+	}
+	if (!(opt & CONSOLE_PRINT_NO_LEAD))
+		*--p = lead;
+	return p;
+}
+
+// Staging output in the line is done by the generic output routine, so an application's consolePrint(), like FConsole's, cannot use it.
+#if defined(CONSOLE_OUTPUT_SHARE_INPUT_BUFFER) && !defined(CONSOLE_DEFINE_PRINT)
+#error CONSOLE_OUTPUT_SHARE_INPUT_BUFFER requires CONSOLE_DEFINE_PRINT
+#endif
+
 // Generic output routine.
 #ifdef CONSOLE_DEFINE_PRINT
-void consolePrint(console_small_uint_t opt, console_int_t x) {
+
+// Older configs only supply a printf.
+#ifndef CONSOLE_OUTPUT_WRITE
+ #define CONSOLE_OUTPUT_WRITE(buf_, n_) CONSOLE_PRINTF(CONSOLE_PSTR("%.*s"), (int)(n_), (buf_))
+#endif
+
+#if defined(CONSOLE_OUTPUT_BUFFER_SIZE) && defined(CONSOLE_OUTPUT_SHARE_INPUT_BUFFER)
+#error CONSOLE_OUTPUT_SHARE_INPUT_BUFFER replaces CONSOLE_OUTPUT_BUFFER_SIZE
+#endif
+
+#if defined(CONSOLE_OUTPUT_BUFFER_SIZE) || defined(CONSOLE_OUTPUT_SHARE_INPUT_BUFFER)
+/* Output buffer, written with CONSOLE_OUTPUT_WRITE() on a newline or when full. If the input buffer is shared the buffer is the part of the line 
+	that consoleProcess() has consumed, outside consoleProcess() it is empty and output is written directly. */
+#ifndef CONSOLE_MULTI_CONTEXT
+#ifdef CONSOLE_OUTPUT_BUFFER_SIZE
+static console_output_context_t f_output_context = { f_output_context.buf, f_output_context.buf, &f_output_context.buf[CONSOLE_OUTPUT_BUFFER_SIZE], { 0 } };
+#else
+static console_output_context_t f_output_context;
+#endif
+#endif
+
+void consoleOutputFlush(void) {
+	if (OUTPUT_CTX.p > OUTPUT_CTX.start)
+		CONSOLE_OUTPUT_WRITE(OUTPUT_CTX.start, (size_t)(OUTPUT_CTX.p - OUTPUT_CTX.start));
+	OUTPUT_CTX.p = OUTPUT_CTX.start;
+}
+
+static void output_write(const char* s, size_t n) {
+	while (n > 0) {
+		if (OUTPUT_CTX.p >= OUTPUT_CTX.end) {
+			consoleOutputFlush();
+			if (OUTPUT_CTX.start == OUTPUT_CTX.end) {		// No buffer, so write directly.
+				CONSOLE_OUTPUT_WRITE(s, n);
+				return;
+			}
+		}
+		size_t nw = (size_t)(OUTPUT_CTX.end - OUTPUT_CTX.p);
+		if (nw > n)
+			nw = n;
+		memcpy(OUTPUT_CTX.p, s, nw);
+		OUTPUT_CTX.p += nw;
+		s += nw;
+		n -= nw;
+	}
+}
+static void output_char(char c) {
+	if (OUTPUT_CTX.p < OUTPUT_CTX.end)
+		*OUTPUT_CTX.p++ = c;
+	else
+		output_write(&c, 1);
+}
+
+#ifdef CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+// Called by consoleProcess() to give output the part of the line that has been consumed, and with NULLs to take it back when done.
+static void output_share(char* start, char* end) {
+	if (start != OUTPUT_CTX.start) {
+		consoleOutputFlush();
+		OUTPUT_CTX.start = OUTPUT_CTX.p = start;
+	}
+	OUTPUT_CTX.end = end;
+}
+#endif
+
+#ifdef CONSOLE_USE_PRINTF
+// Format into the buffer, flushing it first if there is not room.
+static void output_printf(const char* fmt, ...) {
+	va_list ap;
+	while (1) {
+		const size_t room = (size_t)(OUTPUT_CTX.end - OUTPUT_CTX.p);
+		va_start(ap, fmt);
+		const int n = CONSOLE_VSNPRINTF(OUTPUT_CTX.p, room, fmt, ap);
+		va_end(ap);
+		if ((n >= 0) && ((size_t)n < room)) {		// Fitted with room for the nul, which we do not want.
+			OUTPUT_CTX.p += n;
+			break;
+		}
+		if ((n < 0) || (OUTPUT_CTX.p == OUTPUT_CTX.start)) {	// Cannot fit in an empty buffer, so write directly.
+			char tmp[CONSOLE_FORMAT_BUFFER_SIZE];
+			va_start(ap, fmt);
+			const int nt = CONSOLE_VSNPRINTF(tmp, sizeof(tmp), fmt, ap);
+			va_end(ap);
+			if (nt > 0)
+				CONSOLE_OUTPUT_WRITE(tmp, ((size_t)nt < sizeof(tmp)) ? (size_t)nt : sizeof(tmp) - 1);
+			break;
+		}
+		consoleOutputFlush();
+	}
+}
+#endif // CONSOLE_USE_PRINTF
+#else
+void consoleOutputFlush(void) { }
+static void output_write(const char* s, size_t n) { CONSOLE_OUTPUT_WRITE(s, n); }
+static void output_char(char c) { output_write(&c, 1); }
+#define output_printf CONSOLE_PRINTF
+#endif // CONSOLE_OUTPUT_BUFFER_SIZE || CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+
+static void output_str(const char* s) { output_write(s, strlen(s)); }
+static void output_str_p(const char* s) {
+	char c;
+	while ('\0' != (c = (char)CONSOLE_READ_BYTE(s++)))
+		output_char(c);
+}
+
+#ifdef CONSOLE_USE_PRINTF
+void consolePrint(console_small_uint_t opt, console_arg_t x) {
 	switch (opt & ~(CONSOLE_PRINT_NO_LEAD|CONSOLE_PRINT_NO_SEP)) {
-		case CONSOLE_PRINT_NEWLINE:		CONSOLE_PRINTF(CONSOLE_PSTR(CONSOLE_OUTPUT_NEWLINE_STR)); (void)x; return;	// No separator.
+		case CONSOLE_PRINT_NEWLINE:		output_str_p(CONSOLE_PSTR(CONSOLE_OUTPUT_NEWLINE_STR)); consoleOutputFlush(); (void)x; return;	// No separator.
 		default:						(void)x; return;						// Ignore, print nothing.
-		case CONSOLE_PRINT_SIGNED:		CONSOLE_PRINTF(CONSOLE_PSTR("%" CONSOLE_PRINTF_FMT_MOD "d"), x); break;
-		case CONSOLE_PRINT_UNSIGNED:	if (!(opt & CONSOLE_PRINT_NO_LEAD)) CONSOLE_PRINTF(CONSOLE_PSTR("+"));
-										CONSOLE_PRINTF(CONSOLE_PSTR("%" CONSOLE_PRINTF_FMT_MOD "u"), (console_uint_t)x); break;
-		case CONSOLE_PRINT_HEX:			if (!(opt & CONSOLE_PRINT_NO_LEAD)) CONSOLE_PRINTF(CONSOLE_PSTR("$"));
-										CONSOLE_PRINTF(CONSOLE_PSTR("%0*" CONSOLE_PRINTF_FMT_MOD "X"), (int)sizeof(console_uint_t)*2, (console_uint_t)x); break;
-		case CONSOLE_PRINT_HEX2:		if (!(opt & CONSOLE_PRINT_NO_LEAD)) CONSOLE_PRINTF(CONSOLE_PSTR("$"));
-										CONSOLE_PRINTF(CONSOLE_PSTR("%02" CONSOLE_PRINTF_FMT_MOD "X"), (console_uint_t)x & 0xff); break;
-		case CONSOLE_PRINT_STR_P:		CONSOLE_PRINTF(CONSOLE_PSTR("%" CONSOLE_PRINTF_FMT_PSTR), (const char*)x); break;
-		case CONSOLE_PRINT_STR:			CONSOLE_PRINTF(CONSOLE_PSTR("%s"), (const char*)x); break;
-		case CONSOLE_PRINT_CHAR:		CONSOLE_PRINTF(CONSOLE_PSTR("%c"), (char)x); break;
+		case CONSOLE_PRINT_SIGNED:		output_printf(CONSOLE_PSTR("%" CONSOLE_PRINTF_FMT_MOD "d"), (console_int_t)x); break;
+		case CONSOLE_PRINT_UNSIGNED:	if (!(opt & CONSOLE_PRINT_NO_LEAD)) output_char('+');
+										output_printf(CONSOLE_PSTR("%" CONSOLE_PRINTF_FMT_MOD "u"), (console_uint_t)x); break;
+		case CONSOLE_PRINT_HEX:			if (!(opt & CONSOLE_PRINT_NO_LEAD)) output_char('$');
+										output_printf(CONSOLE_PSTR("%0*" CONSOLE_PRINTF_FMT_MOD "X"), (int)sizeof(console_uint_t)*2, (console_uint_t)x); break;
+		case CONSOLE_PRINT_HEX2:		if (!(opt & CONSOLE_PRINT_NO_LEAD)) output_char('$');
+										output_printf(CONSOLE_PSTR("%02" CONSOLE_PRINTF_FMT_MOD "X"), (console_uint_t)x & 0xff); break;
+		case CONSOLE_PRINT_STR_P:		output_str_p((const char*)(uintptr_t)x); break;
+		case CONSOLE_PRINT_STR:			output_str((const char*)(uintptr_t)x); break;
+		case CONSOLE_PRINT_CHAR:		output_char((char)x); break;
 	}
-	if (!(opt & CONSOLE_PRINT_NO_SEP))	CONSOLE_PRINTF(CONSOLE_PSTR(" "));								// Print a space.
+	if (!(opt & CONSOLE_PRINT_NO_SEP))	output_char(' ');								// Print a space.
 }
-#endif
+#else
+void consolePrint(console_small_uint_t opt, console_arg_t x) {
+	char buf[CONSOLE_FORMAT_BUFFER_SIZE];
+	char* const end = &buf[sizeof(buf)];
+	const char* p = consoleFormatNumber(end, opt, x);
+	if (NULL != p) {								// Number with lead char & separator in one write.
+		output_write(p, (size_t)(end - p));
+		return;
+	}
+
+	switch (opt & ~(CONSOLE_PRINT_NO_LEAD|CONSOLE_PRINT_NO_SEP)) {
+		case CONSOLE_PRINT_NEWLINE:		output_str_p(CONSOLE_PSTR(CONSOLE_OUTPUT_NEWLINE_STR)); consoleOutputFlush(); return;	// No separator.
+		default:						return;						// Ignore, print nothing.
+		case CONSOLE_PRINT_STR_P:		output_str_p((const char*)(uintptr_t)x); break;
+		case CONSOLE_PRINT_STR:			output_str((const char*)(uintptr_t)x); break;
+		case CONSOLE_PRINT_CHAR:		output_char((char)x); break;
+	}
+	if (!(opt & CONSOLE_PRINT_NO_SEP))	output_char(' ');								// Print a space.
+}
+#endif // CONSOLE_USE_PRINTF
+#endif // CONSOLE_DEFINE_PRINT
 
 #ifdef CONSOLE_DEFINE_PRINT_ARDUINO
-void consolePrint(uint_least8_t opt, console_int_t x) {
+void consolePrint(uint_least8_t opt, console_arg_t x) {
+	char buf[CONSOLE_FORMAT_BUFFER_SIZE];
+	char* const end = &buf[sizeof(buf)];
+	const char* p = consoleFormatNumber(end, opt, x);
+	if (NULL != p) {								// Number with lead char & separator in one write.
+		CONSOLE_ARDUINO_STREAM.write((const uint8_t*)p, (size_t)(end - p));
+		return;
+	}
+
 	switch (opt & ~(CONSOLE_PRINT_NO_SEP|CONSOLE_PRINT_NO_LEAD)) {
-		case CONSOLE_PRINT_NEWLINE:		CONSOLE_ARDUINO_STREAM.print(F(CONSOLE_OUTPUT_NEWLINE_STR)); (void)x; return; 	// No separator.
-		default:						(void)x; return;															// Ignore, print nothing.
-		case CONSOLE_PRINT_SIGNED:		CONSOLE_ARDUINO_STREAM.print(x, DEC); break;
-		case CONSOLE_PRINT_UNSIGNED:	if (opt & CONSOLE_PRINT_NO_LEAD) CONSOLE_ARDUINO_STREAM.print('+');
-										CONSOLE_ARDUINO_STREAM.print((console_uint_t)x, DEC); break;
-		case CONSOLE_PRINT_HEX2:		if (opt & CONSOLE_PRINT_NO_LEAD) CONSOLE_ARDUINO_STREAM.print('$');
-										if ((console_uint_t)x <= 0x0f) CONSOLE_ARDUINO_STREAM.print(0);
-										CONSOLE_ARDUINO_STREAM.print((console_uint_t)x & 0xffU, HEX); break;
-		case CONSOLE_PRINT_HEX:			if (opt & CONSOLE_PRINT_NO_LEAD) CONSOLE_ARDUINO_STREAM.print('$');
-										for (console_uint_t m = 0xf; CONSOLE_UINT_MAX != m; m = (m << 4) | 0xf) {
-											if ((console_uint_t)x <= m)
-												CONSOLE_ARDUINO_STREAM.print(0);
-										}
-										CONSOLE_ARDUINO_STREAM.print((console_uint_t)x, HEX); break;
-		case CONSOLE_PRINT_STR:			CONSOLE_ARDUINO_STREAM.print((const char*)x); break;
-		case CONSOLE_PRINT_STR_P:		CONSOLE_ARDUINO_STREAM.print((const __FlashStringHelper*)x); break;
+		case CONSOLE_PRINT_NEWLINE:		CONSOLE_ARDUINO_STREAM.print(F(CONSOLE_OUTPUT_NEWLINE_STR)); return; 	// No separator.
+		default:						return;															// Ignore, print nothing.
+		case CONSOLE_PRINT_STR:			CONSOLE_ARDUINO_STREAM.print((const char*)(uintptr_t)x); break;
+		case CONSOLE_PRINT_STR_P:		CONSOLE_ARDUINO_STREAM.print((const __FlashStringHelper*)(uintptr_t)x); break;
 		case CONSOLE_PRINT_CHAR:		CONSOLE_ARDUINO_STREAM.print((char)x); break;
 	}
 	if (!(opt & CONSOLE_PRINT_NO_SEP))	CONSOLE_ARDUINO_STREAM.print(' ');			// Print a space.
 }
 #endif
 
-static bool is_whitespace(char c) { return (' ' == c) || ('\t' == c); }
-static bool is_nul(char c) { return ('\0' == c); }
+#if defined(CONSOLE_BINARY_FRAME_CHAR) || defined(CONSOLE_WANT_DUMP)
+// Write binary in one go, as consolePrint() may be the application's & only print chars.
+static void write_raw(const uint8_t* p, size_t n) {
+#if defined(CONSOLE_DEFINE_PRINT)
+	output_write((const char*)p, n);
+#elif defined(CONSOLE_DEFINE_PRINT_ARDUINO)
+	CONSOLE_ARDUINO_STREAM.write(p, n);
+#else
+	while (n-- > 0)
+		consolePrint(CONSOLE_PRINT_CHAR|CONSOLE_PRINT_NO_SEP, (console_arg_t)*p++);
+#endif
+	consoleOutputFlush();
+}
+#endif
+
+// Optional memory dump commands.
+#ifdef CONSOLE_WANT_DUMP
+#define DUMP_LINE_BYTES 16U
+
+/* Dump RAM or PROGMEM as lines of the address & 16 hex bytes, each formatted into a buffer & printed in one go, or as raw bytes. The address
+	printed is the one given, or the offset from it if cells are handles. */
+static void dump(bool progmem, bool binary) {
+	console_uint_t n = (console_uint_t)console_u_pop();
+	const console_int_t a = console_u_pop();
+	const uint8_t* p = (const uint8_t*)console_cell_to_ptr(a);
+#ifdef CONSOLE_ADDRESS_HANDLES
+	console_uint_t addr = 0;
+#else
+	console_uint_t addr = (console_uint_t)a;
+#endif
+	if (binary && !progmem) {						// Straight from RAM in one write.
+		write_raw(p, (size_t)n);
+		return;
+	}
+
+	char line[sizeof(CONSOLE_OUTPUT_NEWLINE_STR) + 1 + CONSOLE_CELL_SIZE * 2 + DUMP_LINE_BYTES * 3];	// Room for the nul.
+	while (n > 0) {
+		const console_small_uint_t len = (n < DUMP_LINE_BYTES) ? (console_small_uint_t)n : (console_small_uint_t)DUMP_LINE_BYTES;
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+		console_poll_abort();
+#endif
+		if (binary) {								// PROGMEM is copied a line at a time.
+			for (console_small_uint_t i = 0; i < len; i += 1)
+				line[i] = (char)CONSOLE_READ_BYTE(p++);
+			write_raw((const uint8_t*)line, len);
+		}
+		else {
+			char* q = line;
+			memcpy(q, CONSOLE_OUTPUT_NEWLINE_STR, sizeof(CONSOLE_OUTPUT_NEWLINE_STR) - 1);
+			q += sizeof(CONSOLE_OUTPUT_NEWLINE_STR) - 1;
+			*q++ = '$';
+			q += CONSOLE_CELL_SIZE * 2;
+			format_hex(q, addr, CONSOLE_CELL_SIZE * 2);
+			for (console_small_uint_t i = 0; i < len; i += 1) {
+				*q++ = ' ';
+				q += 2;
+				format_hex(q, progmem ? CONSOLE_READ_BYTE(p) : *p, 2);
+				p += 1;
+			}
+			*q = '\0';
+			consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(line));
+		}
+		addr += len;
+		n -= len;
+	}
+	consoleOutputFlush();
+}
+
+bool console_cmds_dump(char* cmd) {
+	switch (console_hash(cmd)) {
+		case /** DUMP (a u - ) Print u bytes of RAM from a as lines of address & 16 hex bytes. **/ 0x4fe9: dump(false, false); break;
+		case /** DUMP-P (a u - ) Print u bytes of PROGMEM from a as lines of address & 16 hex bytes. **/ 0xf1f4: dump(true, false); break;
+		case /** DUMP-B (a u - ) Write u bytes of RAM from a raw. **/ 0xf1e6: dump(false, true); break;
+		case /** DUMP-PB (a u - ) Write u bytes of PROGMEM from a raw. **/ 0x3036: dump(true, true); break;
+		default: return false;
+	}
+	return true;
+}
+#endif // CONSOLE_WANT_DUMP
 
 // Execute a single command from a string
 static console_rc_t execute(char* cmd) {
@@ -406,37 +921,160 @@ static console_rc_t execute(char* cmd) {
 
 void consoleInit(void) {
 	console_u_clear();
+#ifdef CONSOLE_ADDRESS_HANDLES
+	address_clear();
+#endif
+#ifdef CONSOLE_SCRATCH_SIZE
+	scratch_clear();
+#endif
+#ifdef CONSOLE_STRING_HEAP_SIZE
+	heap_clear();
+#endif
+#ifdef CONSOLE_TASKS
+	tasks_clear();
+#endif
+#ifdef CONSOLE_FRAME_REPLAY
+	replay_clear();
+#endif
 }
 
-console_rc_t consoleProcess(char* str, const char** current) {
-	char* volatile cmd;				// Necessary to avoid warning from setjmp clobber variables optimised into registers.
-	char* volatile vstr = str;
+#ifdef CONSOLE_MULTI_CONTEXT
+void consoleSetContext(console_t* con) { f_console_current = con; }
+console_t* consoleGetContext(void) { return f_console_current; }
+
+void consoleInitContext(console_t* con, void* user) {
+	memset(con, 0, sizeof(*con));
+	con->user = user;
+#if defined(CONSOLE_HAVE_OUTPUT_CONTEXT) && defined(CONSOLE_OUTPUT_BUFFER_SIZE)
+	con->output.p = con->output.start = con->output.buf;
+	con->output.end = &con->output.buf[CONSOLE_OUTPUT_BUFFER_SIZE];
+#endif
+	consoleSetContext(con);
+	consoleInit();
+}
+
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+void consoleAbortContext(console_t* con) { con->ctx.abort_req = true; }
+#endif
+
+console_rc_t consoleProcessContext(console_t* con, char* str, const char** current) {
+	consoleSetContext(con);
+	return consoleProcess(str, current);
+}
+#endif // CONSOLE_MULTI_CONTEXT
+
+// Clear per line state before running a line.
+static void process_begin(void) {
+#ifdef CONSOLE_ADDRESS_HANDLES
+	address_clear();				// Handles from the previous line are no longer valid.
+#endif
+#ifdef CONSOLE_SCRATCH_SIZE
+	scratch_clear();				// As are strings.
+#endif
+#if defined(CONSOLE_OUTPUT_SHARE_INPUT_BUFFER) && !defined(CONSOLE_SCRATCH_SIZE)
+	CTX.pin = NULL;
+#endif
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+	CTX.abort_req = false;			// Nothing was running to abort.
+#endif
+#ifdef CONSOLE_PROCESS_STEP
+	CTX.yield_cmd = NULL;			// Abandon any command that yielded on the last line.
+	CTX.yield_state = 0;
+#endif
+}
+
+#ifdef CONSOLE_PROCESS_STEP
+#define yield_pending() (NULL != CTX.yield_cmd)
+#else
+#define yield_pending() false
+#endif
+
+/* Run commands in line str from *pos, at most max_tokens of them if not zero. On return *pos is after the last command run, and 
+	CONSOLE_RC_STAT_PROC_PEND is returned if stopped short of the end by max_tokens or by a command yielding. A command that yields counts as a 
+	token each time it is called. */
+static console_rc_t process(char* str, char** pos, console_small_uint_t max_tokens, const char** current) {
+	char* volatile cmd = NULL;		// Necessary to avoid warning from setjmp clobber variables optimised into registers.
+	char* volatile vstr = *pos;
+	volatile console_small_uint_t tokens = max_tokens;
 	console_rc_t command_rc;
+	(void)str;						// Only used if output shares the line.
 
 	// Establish a point where raise will go to when raise() is called.
-	command_rc = (console_rc_t)setjmp(f_console_ctx.jmpbuf);
+	command_rc = (console_rc_t)setjmp(CTX.jmpbuf);
 	if (CONSOLE_RC_OK != command_rc) 	// On a raise we get here, normal program flow will return zero.
 		goto error;						// Handle error and bail.
 
 	// Iterate over input, breaking into words.
 	while (1) {
-		while (is_whitespace(*vstr)) 									// Advance past leading spaces.
-			vstr += 1;
+		if (!yield_pending()) {
+			while (is_whitespace(*vstr)) 								// Advance past leading spaces.
+				vstr += 1;
 
-		if (is_nul(*vstr))												// Stop at end.
-			break;
+			if (is_nul(*vstr))											// Stop at end.
+				break;
+		}
 
-		// Record start & advance until we see a space.
-		cmd = vstr;
-		while ((!is_whitespace(*vstr)) && (!is_nul(*vstr)))
-			vstr += 1;
+		if (max_tokens && (0 == tokens--)) {							// Stop short, leaving the rest for next time.
+#ifdef CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+			output_share(NULL, NULL);
+#endif
+			*pos = vstr;
+			return CONSOLE_RC_STAT_PROC_PEND;
+		}
 
-		if (!is_nul(*vstr))								// If there was NOT already a nul at the end of this string...
-			*vstr++ = '\0';								// Terminate white space delimited command and advance to next char.
+#ifdef CONSOLE_PROCESS_STEP
+		if (yield_pending()) {							// Call a command that yielded again.
+			cmd = CTX.yield_cmd;
+			CTX.yield_cmd = NULL;
+		}
+		else
+#endif
+		{
+			// Record start & advance until we see a space.
+			cmd = vstr;
+			while ((!is_whitespace(*vstr)) && (!is_nul(*vstr)))
+				vstr += 1;
+
+			if (!is_nul(*vstr))							// If there was NOT already a nul at the end of this string...
+				*vstr++ = '\0';							// Terminate white space delimited command and advance to next char.
+		}
 
+#ifdef CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+#ifdef CONSOLE_SCRATCH_SIZE
+		output_share(str, cmd);							// Output may use the line up to this command.
+#else
+		output_share(str, ((NULL != CTX.pin) && (CTX.pin < cmd)) ? CTX.pin : cmd);	// But not over any strings.
+#endif
+#endif
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+		console_poll_abort();							// Safe point between commands.
+#endif
+#ifdef CONSOLE_TASKS
+		CTX.line_rest = vstr;							// For commands that take the rest of the line.
+#endif
 		command_rc = execute(cmd);						// Try to execute command.
+#ifdef CONSOLE_PROCESS_STEP
+		CTX.yield_state = 0;							// Command done, the next starts afresh.
+#endif
 		if (CONSOLE_RC_OK != command_rc) {				// Bail on error.
-error:		if (command_rc < CONSOLE_RC_OK) // Negative error codes are not really errors, used to implement things like comments.
+error:
+#ifdef CONSOLE_PROCESS_STEP
+			if (CONSOLE_RC_STAT_YIELD == command_rc) {	// Return, the command is called again first thing on the next call.
+				CTX.yield_cmd = cmd;
+				if (NULL != current)					// So the caller can say what is still running.
+					*current = cmd;
+#ifdef CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+				output_share(NULL, NULL);
+#endif
+				*pos = vstr;
+				return CONSOLE_RC_STAT_PROC_PEND;
+			}
+			CTX.yield_state = 0;
+#endif
+#ifdef CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+			output_share(NULL, NULL);					// Write output before the caller uses the line.
+#endif
+			if (command_rc < CONSOLE_RC_OK) // Negative error codes are not really errors, used to implement things like comments.
 				return CONSOLE_RC_OK;		// Fake no error to caller.
 
 			if (NULL != current)	// Update user pointer to point to last command executed, good for error messages.
@@ -445,9 +1083,368 @@ error:		if (command_rc < CONSOLE_RC_OK) // Negative error codes are not really e
 		}
 	}
 
+#ifdef CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+	output_share(NULL, NULL);
+#endif
 	return CONSOLE_RC_OK;
 }
 
+console_rc_t consoleProcess(char* str, const char** current) {
+	char* pos = str;
+	console_rc_t rc;
+	process_begin();
+	do
+		rc = process(str, &pos, 0, current);
+	while (CONSOLE_RC_STAT_PROC_PEND == rc);		// A command yielded, so call it again at once.
+	return rc;
+}
+
+#ifdef CONSOLE_PROCESS_STEP
+void consoleProcessBegin(char* str) {
+	process_begin();
+	CTX.step_line = CTX.step_p = str;
+}
+
+console_rc_t consoleProcessStep(console_small_uint_t max_tokens, const char** current) {
+	if (NULL == CTX.step_p)						// No line, or finished.
+		return CONSOLE_RC_OK;
+	const console_rc_t rc = process(CTX.step_line, &CTX.step_p, max_tokens, current);
+	if (CONSOLE_RC_STAT_PROC_PEND != rc)
+		CTX.step_line = CTX.step_p = NULL;
+	return rc;
+}
+#endif // CONSOLE_PROCESS_STEP
+
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+// The reply's length byte must be able to hold the whole stack.
+STATIC_ASSERT(CONSOLE_FRAME_REPLY_SIZE < 255);
+
+#ifdef CONSOLE_FRAME_CRC
+// Table for CRC-16/CCITT-FALSE, polynomial 0x1021, a byte at a time.
+static const uint16_t CRC16_TABLE[256] CONSOLE_PROGMEM = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+	0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+	0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+	0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+	0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+	0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+	0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+	0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+	0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+	0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+	0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+	0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+	0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+	0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+	0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+	0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+	0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+	0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+	0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+	0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+	0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+uint16_t console_crc16(const void* p, size_t n) {
+	const uint8_t* b = (const uint8_t*)p;
+	uint16_t crc = 0xffff;
+	while (n-- > 0)
+		crc = (uint16_t)((crc << 8) ^ CONSOLE_READ_U16(&CRC16_TABLE[(uint8_t)((crc >> 8) ^ *b++)]));
+	return crc;
+}
+#define FRAME_HEADER_SIZE 4							// Char, length, length check & sequence number.
+#else
+#define FRAME_HEADER_SIZE 2							// Char & length.
+#endif // CONSOLE_FRAME_CRC
+
+#ifdef CONSOLE_FRAME_REPLAY
+// Return the cached reply to the frame with this sequence number & CRC, or NULL. A different frame that reuses the number is not a resend.
+static const uint8_t* replay_find(uint8_t seq, uint16_t crc) {
+	for (console_small_uint_t i = 0; i < CONSOLE_FRAME_REPLAY; i += 1) {
+		const uint8_t* const r = CTX.replay[i];
+		if ((0 != r[1]) && (seq == r[3]) && (crc == CTX.replay_crc[i]))
+			return r;
+	}
+	return NULL;
+}
+#endif // CONSOLE_FRAME_REPLAY
+
+static console_uint_t frame_get_cell(const uint8_t* p) {
+	console_uint_t x = 0;
+	for (console_small_uint_t i = CONSOLE_CELL_SIZE; i > 0; i -= 1)
+		x = (console_uint_t)((x << 8) | p[i - 1]);
+	return x;
+}
+
+
+/* Run the n bytes of a frame's body, the count of cells, the cells & maybe a hash. The status & then the stack are written at *rp, which is 
+	advanced, and the stack is emptied. */
+static console_rc_t frame_run(const uint8_t* f, size_t n, uint8_t** rp) {
+	const console_small_uint_t ncells = (n > 0) ? f[0] : 0;
+	const size_t cells_len = 1U + (size_t)ncells * CONSOLE_CELL_SIZE;
+	const bool has_cmd = (n == cells_len + 2U);
+	volatile bool pushed = false;
+	console_rc_t rc;
+
+	process_begin();
+#ifdef CONSOLE_TASKS
+	CTX.line_rest = &f_frame_cmd[sizeof(f_frame_cmd) - 1];	// There is no rest of the line.
+#endif
+	if ((0 == n) || (!has_cmd && (n != cells_len)))
+		rc = CONSOLE_RC_ERR_BAD_FRAME;
+	else {
+		do {
+			rc = (console_rc_t)setjmp(CTX.jmpbuf);
+			if (CONSOLE_RC_OK == rc) {
+				if (!pushed) {
+					console_verify_can_push(ncells);
+					for (const uint8_t* p = &f[1]; p < &f[cells_len]; p += CONSOLE_CELL_SIZE)
+						console_u_push((console_int_t)frame_get_cell(p));
+					pushed = true;
+				}
+				if (has_cmd) {
+					CTX.frame_hash = (uint16_t)(f[cells_len] | (f[cells_len + 1U] << 8));
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+					console_poll_abort();
+#endif
+					rc = execute(f_frame_cmd);
+				}
+			}
+		} while (CONSOLE_RC_STAT_YIELD == rc);		// A command that yields is called again at once, as with consoleProcess().
+#ifdef CONSOLE_PROCESS_STEP
+		CTX.yield_state = 0;
+#endif
+		if (rc < CONSOLE_RC_OK)						// Status codes are not errors.
+			rc = CONSOLE_RC_OK;
+	}
+
+	uint8_t* p = *rp;
+	*p++ = (uint8_t)rc;
+	for (console_small_uint_t i = console_u_depth(); i > 0; i -= 1) {
+		console_uint_t x = (console_uint_t)CTX.sp[i - 1];
+		for (console_small_uint_t b = 0; b < CONSOLE_CELL_SIZE; b += 1) {
+			*p++ = (uint8_t)x;
+			x = (console_uint_t)(x >> 8);
+		}
+	}
+	console_u_clear();
+	*rp = p;
+	return rc;
+}
+
+console_rc_t consoleProcessFrame(const char* frame) {
+	const uint8_t* const f = (const uint8_t*)frame;
+	uint8_t reply[CONSOLE_FRAME_REPLY_SIZE];
+	uint8_t* p = &reply[FRAME_HEADER_SIZE];
+	console_rc_t rc;
+#ifdef CONSOLE_FRAME_REPLAY
+	bool checked = false;							// Only the reply to a frame that passed its checks is kept, a bad frame is not run.
+#endif
+
+#ifdef CONSOLE_FRAME_CRC
+	const size_t n = f[0];							// Sequence number, body & CRC.
+	const uint16_t frame_crc = (n < 3) ? 0U : (uint16_t)(f[n - 1U] | (f[n] << 8));
+	reply[3] = (n > 0) ? f[1] : 0;					// Sequence number is returned even if the frame is bad, so the host knows which to resend.
+	if (n < 3)
+		rc = CONSOLE_RC_ERR_BAD_FRAME;
+	else if (console_crc16(&f[1], n - 2U) != frame_crc)
+		rc = CONSOLE_RC_ERR_BAD_CRC;				// Not run, the host resends it.
+	else {
+#ifdef CONSOLE_FRAME_REPLAY
+		const uint8_t* const r = replay_find(f[1], frame_crc);
+		if (NULL != r) {							// Sent again as the reply was lost, so it is not run again.
+			write_raw(r, (size_t)r[1] + 3U);
+			return (console_rc_t)r[4];
+		}
+		checked = true;
+#endif
+		rc = frame_run(&f[2], n - 3U, &p);
+	}
+	if (p == &reply[FRAME_HEADER_SIZE])				// Not run so just the status.
+		*p++ = (uint8_t)rc;
+	const uint16_t crc = console_crc16(&reply[3], (size_t)(p - &reply[3]));
+	*p++ = (uint8_t)crc;
+	*p++ = (uint8_t)(crc >> 8);
+	reply[1] = (uint8_t)(p - &reply[3]);
+	reply[2] = (uint8_t)~reply[1];
+#else
+	rc = frame_run(&f[1], f[0], &p);
+	reply[1] = (uint8_t)(p - &reply[2]);
+#endif
+	reply[0] = (uint8_t)CONSOLE_BINARY_FRAME_CHAR;
+	write_raw(reply, (size_t)(p - reply));
+#ifdef CONSOLE_FRAME_REPLAY
+	if (checked) {									// Keep the reply in case the host sends the frame again.
+		memcpy(CTX.replay[CTX.replay_next], reply, (size_t)(p - reply));
+		CTX.replay_crc[CTX.replay_next] = frame_crc;
+		CTX.replay_next = (console_small_uint_t)((CTX.replay_next + 1U) % CONSOLE_FRAME_REPLAY);
+	}
+#endif
+	return rc;
+}
+#endif // CONSOLE_BINARY_FRAME_CHAR
+
+#ifdef CONSOLE_MULTITASK
+static console_tcb_t f_tcbs[CONSOLE_MULTITASK];
+static console_small_uint_t f_tcb_next;				// Next to run, so that each gets a turn.
+
+console_tcb_t* consoleMultitaskSpawn(const char* script, bool repeat, void* user) {
+	for (console_small_uint_t i = 0; i < CONSOLE_MULTITASK; i += 1) {
+		console_tcb_t* const t = &f_tcbs[i];
+		if (NULL == t->script) {
+			console_t* const saved = consoleGetContext();
+			consoleInitContext(&t->con, user);
+			consoleSetContext(saved);
+			t->script = t->next = script;
+			t->repeat = repeat;
+			return t;
+		}
+	}
+	return NULL;
+}
+
+void consoleMultitaskStop(console_tcb_t* t) { t->script = NULL; }
+
+// Start the task's next line, copied into its accept buffer which is idle as a task takes no input. Returns false at the end of the script.
+static bool tcb_next_line(console_tcb_t* t) {
+	if ('\0' == *t->next) {
+		if (!t->repeat)
+			return false;
+		t->next = t->script;
+	}
+	char* const line = consoleAcceptBuffer();
+	size_t len = 0;
+	while (('\0' != *t->next) && ('\n' != *t->next)) {
+		if (len < CONSOLE_INPUT_BUFFER_SIZE)
+			line[len++] = *t->next;
+		t->next += 1;
+	}
+	if ('\n' == *t->next)
+		t->next += 1;
+	line[len] = '\0';
+	consoleProcessBegin(line);
+	return true;
+}
+
+console_rc_t consoleMultitaskRun(console_tcb_t** task, const char** current) {
+	console_t* const saved = consoleGetContext();
+	console_rc_t rc = CONSOLE_RC_OK;
+	*task = NULL;
+	for (console_small_uint_t n = 0; n < CONSOLE_MULTITASK; n += 1) {
+		const console_small_uint_t i = f_tcb_next;
+		if (++f_tcb_next >= CONSOLE_MULTITASK)
+			f_tcb_next = 0;
+		console_tcb_t* const t = &f_tcbs[i];
+		if (NULL == t->script)
+			continue;
+
+		consoleSetContext(&t->con);
+		if ((NULL == CTX.step_p) && !tcb_next_line(t)) {		// Script done.
+			consoleMultitaskStop(t);
+			continue;
+		}
+		*task = t;
+		rc = consoleProcessStep(0, current);					// Runs to the end of the line or to a PAUSE.
+		if (rc > CONSOLE_RC_OK)									// Errors stop the task.
+			consoleMultitaskStop(t);
+		consoleOutputFlush();
+		break;
+	}
+	consoleSetContext(saved);
+	return rc;
+}
+#endif // CONSOLE_MULTITASK
+
+#ifdef CONSOLE_TASKS
+/* Run a task with its own stack in place of the console's, which is put back after. The task is rescheduled, or freed if it only runs once, 
+	before it runs, so that it may add tasks. */
+static void task_run(console_task_t* t, console_small_uint_t id, uint32_t now) {
+	char line[CONSOLE_TASK_LINE_SIZE];			// The line is written to as it runs.
+	console_int_t saved[CONSOLE_DATA_STACK_SIZE];
+	const console_small_uint_t depth = console_u_depth();
+
+	strcpy(line, t->line);
+	if (0 == t->period)
+		t->line[0] = '\0';
+	else {
+		t->due += t->period;
+		if (task_is_due(t, now))				// Skip runs that were missed rather than run them late in a burst.
+			t->due = now + t->period;
+	}
+	CTX.task_running = (0 != t->period) ? t : NULL;
+
+	memcpy(saved, CTX.sp, depth * sizeof(console_int_t));
+	CTX.sp = CONSOLE_STACKBASE - t->depth;
+	memcpy(CTX.sp, t->stack, t->depth * sizeof(console_int_t));
+
+	consolePrint(CONSOLE_PRINT_CHAR|CONSOLE_PRINT_NO_SEP, '[');			// Tag output with the task id.
+	consolePrint(CONSOLE_PRINT_UNSIGNED|CONSOLE_PRINT_NO_LEAD|CONSOLE_PRINT_NO_SEP, id);
+	consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(CONSOLE_PSTR("]")));
+	const char* cmd = NULL;
+	console_rc_t rc = consoleProcess(line, &cmd);
+	if ((CONSOLE_RC_OK == rc) && (console_u_depth() > CONSOLE_TASK_STACK_SIZE))
+		rc = CONSOLE_RC_ERR_DSTK_OVF;			// Too much left for the task's stack.
+	if (CONSOLE_RC_OK != rc) {
+		if (NULL != cmd)
+			consolePrint(CONSOLE_PRINT_STR, console_ptr_arg(cmd));
+		consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(consoleGetErrorDescription(rc)));
+		if (NULL != CTX.task_running)
+			CTX.task_running->line[0] = '\0';
+	}
+	else if (NULL != CTX.task_running) {		// Keep the stack unless the task has gone.
+		t->depth = (uint8_t)console_u_depth();
+		memcpy(t->stack, CTX.sp, t->depth * sizeof(console_int_t));
+	}
+	consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+	CTX.task_running = NULL;
+
+	CTX.sp = CONSOLE_STACKBASE - depth;
+	memcpy(CTX.sp, saved, depth * sizeof(console_int_t));
+}
+
+console_small_uint_t consoleServiceTasks(uint32_t now) {
+	console_small_uint_t n = 0;
+	CTX.task_now = now;
+	for (console_small_uint_t i = 0; i < CONSOLE_TASKS; i += 1) {
+		console_task_t* const t = &CTX.tasks[i];
+		if (!task_is_free(t) && task_is_due(t, now)) {
+			task_run(t, i + 1, now);
+			n += 1;
+		}
+	}
+	return n;
+}
+
+uint32_t consoleTasksWait(uint32_t now) {
+	uint32_t wait = CONSOLE_TASKS_IDLE;
+	CTX.task_now = now;
+	for (console_small_uint_t i = 0; i < CONSOLE_TASKS; i += 1) {
+		const console_task_t* const t = &CTX.tasks[i];
+		if (!task_is_free(t)) {
+			const uint32_t w = task_is_due(t, now) ? 0 : (t->due - now);
+			if (w < wait)
+				wait = w;
+		}
+	}
+	return wait;
+}
+#endif // CONSOLE_TASKS
+
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+void consoleAbort(void) { CTX.abort_req = true; }
+#endif
+
 // Print description of error code.
 #define CONSOLE_DEF_ERROR_CODE_ERR_STR(v_, s_) case CONSOLE_RC_ERR_ ## v_: return CONSOLE_PSTR(s_);
 
@@ -460,38 +1457,349 @@ const char* consoleGetErrorDescription(console_rc_t err) {
 #undef CONSOLE_DEF_ERROR_CODE_ERR_STR
 
 // Input functions.
-// State for consoleAccept(). Done seperately as if not used the linker will remove it.
-typedef struct {
-	char inbuf[CONSOLE_INPUT_BUFFER_SIZE + 1];
-	console_small_uint_t inbidx;
-} accept_context_t;
-static accept_context_t f_accept_context;
-
-void consoleAcceptClear() {
-	f_accept_context.inbidx = 0;
-}
-
-console_rc_t consoleAccept(char c) {
-	bool overflow = (f_accept_context.inbidx >= sizeof(f_accept_context.inbuf));
+/* Add a char to a line buffer of CONSOLE_INPUT_BUFFER_SIZE+1 chars, returning as for consoleAccept(). On overflow the index is left at 
+	CONSOLE_INPUT_BUFFER_SIZE+1 so that the nul is still written inside the buffer. */
+static console_rc_t accept_char(char* inbuf, console_small_uint_t* inbidx, char c) {
+	const bool overflow = (*inbidx > CONSOLE_INPUT_BUFFER_SIZE);
 
 	if (CONSOLE_INPUT_NEWLINE_CHAR == c) {
-		f_accept_context.inbuf[f_accept_context.inbidx] = '\0';
-		consoleAcceptClear();
+		inbuf[overflow ? CONSOLE_INPUT_BUFFER_SIZE : *inbidx] = '\0';
+		*inbidx = 0;
 		return overflow ? CONSOLE_RC_ERR_ACC_OVF : CONSOLE_RC_OK;
 	}
 	else
 #ifdef CONSOLE_INPUT_CANCEL_CHAR
 	if (CONSOLE_INPUT_CANCEL_CHAR == c) {
-		consoleAcceptClear();
+		*inbidx = 0;
 		return overflow ? CONSOLE_RC_ERR_ACC_OVF : CONSOLE_RC_STAT_ACC_CAN;
 	}
 #endif // CONSOLE_INPUT_CANCEL_CHAR
 	{
 		if ((c >= ' ') && (c < (char)0x7f)) {	 // Is is printable?
-			if (!overflow)
-				f_accept_context.inbuf[f_accept_context.inbidx++] = c;
+			if (*inbidx < CONSOLE_INPUT_BUFFER_SIZE)
+				inbuf[(*inbidx)++] = c;
+			else
+				*inbidx = CONSOLE_INPUT_BUFFER_SIZE + 1;
+		}
+		return CONSOLE_RC_STAT_ACC_PEND;
+	}
+}
+
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+/* States for receiving a binary frame. With CONSOLE_FRAME_CRC the length is followed by its complement, if they do not match the length cannot
+	be trusted, so input is skipped up to the next frame char, or a newline so that someone typing at the console is not locked out. */
+enum { FRAME_NONE, FRAME_LEN, FRAME_LEN_CHECK, FRAME_BODY, FRAME_SKIP };
+#endif
+
+// State for consoleAccept(). Done seperately as if not used the linker will remove it.
+#ifndef CONSOLE_MULTI_CONTEXT
+static console_accept_context_t f_accept_context;
+#endif
+
+void consoleAcceptClear() {
+	ACCEPT_CTX.inbidx = 0;
+#ifdef CONSOLE_BULK_ACK_CHAR
+	ACCEPT_CTX.bulk_left = 0;
+#endif
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	ACCEPT_CTX.frame.state = FRAME_NONE;
+#endif
+}
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+enum { ACCEPT_BUF_FREE, ACCEPT_BUF_READY, ACCEPT_BUF_TAKEN };	// States of the buffer not being filled by the ISR.
+#ifndef CONSOLE_MULTI_CONTEXT
+static console_accept_double_context_t f_accept_double_context;
+#endif
+#endif
+
+#ifdef CONSOLE_BULK_ACK_CHAR
+void consoleSetBulkSink(console_bulk_sink_func sink) { ACCEPT_CTX.bulk_sink = sink; }
+
+// Tell the host to send the next chunk of an upload, or the first.
+static void bulk_ack(void) {
+	consolePrint(CONSOLE_PRINT_CHAR|CONSOLE_PRINT_NO_SEP, CONSOLE_BULK_ACK_CHAR);
+	consoleOutputFlush();
+}
+
+bool console_cmds_bulk(char* cmd) {
+	switch (console_hash(cmd)) {
+		case /** UPLOAD (u - ) Take the next u bytes of input after this line raw & pass them to the bulk sink. **/ 0xc246: {
+			const console_uint_t n = (console_uint_t)console_u_pop();
+			if ((NULL == ACCEPT_CTX.bulk_sink) || (0 == n) || ((uint32_t)n != n))
+				console_raise(CONSOLE_RC_ERR_BAD_IDX);
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+			if (ACCEPT_BUF_TAKEN == ACCEPT_DOUBLE_CTX.state) {			// Line is from consoleAcceptLine(), so the ISR takes the upload.
+				ACCEPT_DOUBLE_CTX.bulk_pending = (uint32_t)n;
+				break;
+			}
+#endif
+			ACCEPT_CTX.bulk_left = (uint32_t)n;				// The line is still being run from the buffer, but it is not used until the line is done.
+			bulk_ack();
+		} break;
+		default: return false;
+	}
+	return true;
+}
+
+// Collect an upload a buffer full at a time, each is passed to the sink & then acked so that the host sends the next.
+static console_rc_t accept_bulk(char c) {
+	ACCEPT_CTX.inbuf[ACCEPT_CTX.inbidx++] = c;
+	ACCEPT_CTX.bulk_left -= 1;
+	if ((ACCEPT_CTX.inbidx >= CONSOLE_INPUT_BUFFER_SIZE) || (0 == ACCEPT_CTX.bulk_left)) {
+		if (NULL != ACCEPT_CTX.bulk_sink)
+			ACCEPT_CTX.bulk_sink((const uint8_t*)ACCEPT_CTX.inbuf, ACCEPT_CTX.inbidx);
+		ACCEPT_CTX.inbidx = 0;
+		bulk_ack();
+	}
+	return CONSOLE_RC_STAT_ACC_PEND;
+}
+#endif // CONSOLE_BULK_ACK_CHAR
+
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+#ifdef CONSOLE_FRAME_CRC
+#define frame_may_start(inbidx_) true				// Anywhere, dropping a partial line, so the link recovers at the next frame.
+#else
+#define frame_may_start(inbidx_) (0 == (inbidx_))	// Only at the start of a line.
+#endif
+
+// Add a byte of a binary frame, the first is its length. Any byte value may be in a frame, & a frame too long for the buffer is skipped.
+static console_rc_t accept_frame_byte(console_frame_rx_t* f, char* inbuf, console_small_uint_t* inbidx, char c) {
+	switch (f->state) {
+		case FRAME_LEN:
+			inbuf[0] = c;
+			*inbidx = 1;
+			f->left = (console_small_uint_t)c;
+#ifdef CONSOLE_FRAME_CRC
+			f->state = FRAME_LEN_CHECK;
+			return CONSOLE_RC_STAT_ACC_PEND;
+		case FRAME_LEN_CHECK:
+			if ((char)~inbuf[0] != c) {
+				f->state = FRAME_SKIP;
+				*inbidx = 0;
+				return CONSOLE_RC_STAT_ACC_PEND;
+			}
+#endif
+			f->state = FRAME_BODY;
+			break;
+		case FRAME_BODY:
+			if (*inbidx <= CONSOLE_INPUT_BUFFER_SIZE)
+				inbuf[(*inbidx)++] = c;
+			f->left -= 1;
+			break;
+		default:
+			return CONSOLE_RC_STAT_ACC_PEND;
+	}
+	if (f->left > 0)
+		return CONSOLE_RC_STAT_ACC_PEND;
+	f->state = FRAME_NONE;
+	*inbidx = 0;
+	return ((uint8_t)inbuf[0] > CONSOLE_INPUT_BUFFER_SIZE) ? CONSOLE_RC_ERR_ACC_OVF : CONSOLE_RC_STAT_ACC_FRAME;
+}
+
+/* Run a char through the frame decoder for a line buffer, for both consoleAccept() & consoleAcceptIsr(). Returns true if it was taken as part 
+	of a frame, with the status in rc, otherwise it is text. */
+static bool accept_frame(console_frame_rx_t* f, char* inbuf, console_small_uint_t* inbidx, char c, console_rc_t* rc) {
+	*rc = CONSOLE_RC_STAT_ACC_PEND;
+	if ((FRAME_NONE != f->state) && (FRAME_SKIP != f->state))
+		*rc = accept_frame_byte(f, inbuf, inbidx, c);
+	else if ((CONSOLE_BINARY_FRAME_CHAR == c) && frame_may_start(*inbidx))
+		f->state = FRAME_LEN;
+	else if (FRAME_SKIP != f->state)
+		return false;
+	else if (CONSOLE_INPUT_NEWLINE_CHAR == c)		// Ends skipping, but is not a line itself.
+		f->state = FRAME_NONE;
+	return true;
+}
+#endif
+
+console_rc_t consoleAccept(char c) {
+#ifdef CONSOLE_BULK_ACK_CHAR
+	if (ACCEPT_CTX.bulk_left > 0)
+		return accept_bulk(c);
+#endif
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	console_rc_t rc;
+	if (accept_frame(&ACCEPT_CTX.frame, ACCEPT_CTX.inbuf, &ACCEPT_CTX.inbidx, c, &rc))
+		return rc;
+#endif
+	return accept_char(ACCEPT_CTX.inbuf, &ACCEPT_CTX.inbidx, c);
+}
+char* consoleAcceptBuffer() { return ACCEPT_CTX.inbuf; }
+#ifdef CONSOLE_MULTI_CONTEXT
+console_rc_t consoleAcceptContext(console_t* con, char c) {
+	consoleSetContext(con);
+	return consoleAccept(c);
+}
+#endif
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+/* Run the following block with the RX interrupt off, for state shared with the ISR that is more than one store. On AVR it is ATOMIC_BLOCK, 
+	elsewhere define it in console-config.h to mask the interrupt. The default only stops the compiler moving stores out of the block, which is 
+	enough where the ISR is idle. */
+#ifndef CONSOLE_ATOMIC
+#if defined(__AVR__)
+#include <util/atomic.h>
+#define CONSOLE_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+#define CONSOLE_ATOMIC for (bool atomic_once_ = (__atomic_signal_fence(__ATOMIC_SEQ_CST), true); atomic_once_; \
+	atomic_once_ = false, __atomic_signal_fence(__ATOMIC_SEQ_CST))
+#endif
+#endif
+
+// Hand the buffer being filled to the main loop if it has released the other, else drop it. A chunk of an upload has its size in bulk_n.
+static void accept_double_ready(console_accept_double_context_t* ctx, console_rc_t rc, console_small_uint_t bulk_n) {
+	if (ACCEPT_BUF_FREE != ctx->state)			// Previous line not yet released, so drop this one.
+		ctx->lost = true;
+	else {
+		ctx->rc = rc;
+#ifdef CONSOLE_BULK_ACK_CHAR
+		ctx->bulk_n = bulk_n;
+#endif
+		ctx->fill ^= 1;
+		ctx->state = ACCEPT_BUF_READY;
+	}
+	(void)bulk_n;
+}
+
+#ifdef CONSOLE_BULK_ACK_CHAR
+// Take a byte of an upload raw, a chunk is handed over when the buffer is full or the upload is done, then input is text again.
+static void accept_isr_bulk(console_accept_double_context_t* ctx, char c) {
+	ctx->inbuf[ctx->fill][ctx->inbidx++] = c;
+	ctx->bulk_left -= 1;
+	if ((ctx->inbidx >= CONSOLE_BULK_CHUNK_SIZE) || (0 == ctx->bulk_left)) {
+		if (0 == ctx->bulk_left)
+			ctx->bulk = false;
+		accept_double_ready(ctx, CONSOLE_RC_STAT_ACC_PEND, ctx->inbidx);
+		ctx->inbidx = 0;
+	}
+}
+#endif
+
+static bool accept_isr(console_accept_double_context_t* ctx, char c) {
+	console_rc_t rc;
+	bool raw = false;
+#ifdef CONSOLE_BULK_ACK_CHAR
+	if (ctx->bulk) {							// No line editing or abort in an upload, any byte value may be sent.
+		accept_isr_bulk(ctx, c);
+		return true;
+	}
+#endif
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	if (accept_frame(&ctx->frame, ctx->inbuf[ctx->fill], &ctx->inbidx, c, &rc))
+		raw = (FRAME_SKIP != ctx->frame.state);	// Skipped input may still be an abort typed at the console.
+	else
+#endif
+		rc = accept_char(ctx->inbuf[ctx->fill], &ctx->inbidx, c);
+	if ((rc >= CONSOLE_RC_OK) || (CONSOLE_RC_STAT_ACC_FRAME == rc))	// Line or frame complete.
+		accept_double_ready(ctx, rc, 0);
+	return raw;
+}
+
+bool consoleAcceptIsr(char c) { return accept_isr(&ACCEPT_DOUBLE_CTX, c); }
+#ifdef CONSOLE_MULTI_CONTEXT
+bool consoleAcceptIsrContext(console_t* con, char c) { return accept_isr(&con->accept_double, c); }
+#endif
+
+console_rc_t consoleAcceptLine(char** line) {
+	console_accept_double_context_t* const ctx = &ACCEPT_DOUBLE_CTX;
+	static char empty;
+
+	if (ACCEPT_BUF_TAKEN == ctx->state) {		// Release the previous line.
+		ctx->state = ACCEPT_BUF_FREE;
+#ifdef CONSOLE_BULK_ACK_CHAR
+		if (0 != ctx->bulk_pending) {			// It ran UPLOAD, the ISR is set up all at once, in case a byte comes before the ack.
+			CONSOLE_ATOMIC {
+				ctx->inbidx = 0;
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+				ctx->frame.state = FRAME_NONE;
+#endif
+				ctx->bulk_left = ctx->bulk_pending;
+				ctx->bulk_pending = 0;
+				ctx->bulk = true;				// Last, so the ISR sees the rest set up when it sees this.
+			}
+			bulk_ack();
 		}
+#endif
+	}
+	if (ctx->lost) {
+		ctx->lost = false;
+		*line = &empty;
+		return CONSOLE_RC_ERR_ACC_OVF;
+	}
+	if (ACCEPT_BUF_READY != ctx->state)
+		return CONSOLE_RC_STAT_ACC_PEND;
+#ifdef CONSOLE_BULK_ACK_CHAR
+	if (0 != ctx->bulk_n) {						// A chunk of an upload is passed to the sink & released at once, then acked for the next.
+		if (NULL != ACCEPT_CTX.bulk_sink)
+			ACCEPT_CTX.bulk_sink((const uint8_t*)ctx->inbuf[ctx->fill ^ 1], ctx->bulk_n);
+		ctx->state = ACCEPT_BUF_FREE;
+		bulk_ack();
 		return CONSOLE_RC_STAT_ACC_PEND;
 	}
+#endif
+	ctx->state = ACCEPT_BUF_TAKEN;
+	*line = ctx->inbuf[ctx->fill ^ 1];
+	return ctx->rc;
+}
+#endif // CONSOLE_ACCEPT_DOUBLE_BUFFER
+
+#ifdef CONSOLE_QUEUE_SIZE
+/* Each side reads its own index relaxed as only it writes it, reads the other's with acquire so it sees the data written before it was 
+	published, and publishes its own with release after it has finished with the data. */
+#define queue_own(p_) __atomic_load_n((p_), __ATOMIC_RELAXED)
+#define queue_load(p_) __atomic_load_n((p_), __ATOMIC_ACQUIRE)
+#define queue_store(p_, v_) __atomic_store_n((p_), (v_), __ATOMIC_RELEASE)
+static console_queue_index_t queue_next(console_queue_index_t i) { return (console_queue_index_t)((i < CONSOLE_QUEUE_SIZE - 1U) ? (i + 1U) : 0U); }
+
+void consoleQueueInit(console_queue_t* q) {
+	q->head = q->tail = 0;
+}
+
+size_t consoleQueueWrite(console_queue_t* q, const char* buf, size_t n) {
+	console_queue_index_t head = queue_own(&q->head);
+	const console_queue_index_t tail = queue_load(&q->tail);
+	size_t i;
+	for (i = 0; i < n; i += 1) {
+		const console_queue_index_t next = queue_next(head);
+		if (next == tail)							// Full.
+			break;
+		q->buf[head] = buf[i];
+		head = next;
+	}
+	queue_store(&q->head, head);
+	return i;
+}
+
+size_t consoleQueueRead(console_queue_t* q, char* buf, size_t n) {
+	console_queue_index_t tail = queue_own(&q->tail);
+	const console_queue_index_t head = queue_load(&q->head);
+	size_t i;
+	for (i = 0; (i < n) && (tail != head); i += 1) {
+		buf[i] = q->buf[tail];
+		tail = queue_next(tail);
+	}
+	queue_store(&q->tail, tail);
+	return i;
+}
+
+console_rc_t consoleServiceQueue(console_queue_t* q, const char** current) {
+	console_queue_index_t tail = queue_own(&q->tail);
+	const console_queue_index_t head = queue_load(&q->head);
+	console_rc_t rc = CONSOLE_RC_STAT_ACC_PEND;
+	while (tail != head) {
+		rc = consoleAccept(q->buf[tail]);
+		tail = queue_next(tail);
+		if ((rc >= CONSOLE_RC_OK) || (CONSOLE_RC_STAT_ACC_FRAME == rc))	// Line or frame complete.
+			break;
+	}
+	queue_store(&q->tail, tail);					// Line is in the accept buffer, so the producer can have the space.
+	if (CONSOLE_RC_OK == rc)
+		return consoleProcess(consoleAcceptBuffer(), current);
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	if (CONSOLE_RC_STAT_ACC_FRAME == rc)
+		return consoleProcessFrame(consoleAcceptBuffer());
+#endif
+	return (rc > CONSOLE_RC_OK) ? rc : CONSOLE_RC_STAT_ACC_PEND;
 }
-char* consoleAcceptBuffer() { return f_accept_context.inbuf; }
+#endif // CONSOLE_QUEUE_SIZE
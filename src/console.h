@@ -7,16 +7,225 @@ extern "C" {
 
 #include "console-config.h"
 
+#include <setjmp.h>
+
 /* Get max/min for types. This only works because we assume two's complement representation
  * and we have checked that the signed & unsigned types are compatible. */
-#define CONSOLE_UINT_MAX (~(console_uint_t)(0))
+#define CONSOLE_UINT_MAX ((console_uint_t)~(console_uint_t)(0))
 #define CONSOLE_INT_MAX ((console_int_t)(CONSOLE_UINT_MAX >> 1))
 #define CONSOLE_INT_MIN ((console_int_t)(~(CONSOLE_UINT_MAX >> 1)))
 
+/* If a cell cannot hold a pointer then addresses on the stack are held as handles into a table of addresses used on the current line. */
+#if defined(__SIZEOF_POINTER__) && (CONSOLE_CELL_SIZE < __SIZEOF_POINTER__)
+ #define CONSOLE_ADDRESS_HANDLES
+#endif
+
+/* Type for the value printed by consolePrint(), which must be able to hold either a cell or a pointer. */
+#ifdef CONSOLE_ADDRESS_HANDLES
+typedef intptr_t console_arg_t;
+#else
+typedef console_int_t console_arg_t;
+#endif
+
+// Pass a pointer to consolePrint().
+#define console_ptr_arg(p_) ((console_arg_t)(uintptr_t)(p_))
+
 /* Recognisers are little parser functions that can turn a string into a value or values that are pushed onto the stack. They return
 	false if they cannot parse the input string. If they do parse it, they might call raise() if they cannot push a value onto the stack. */
 typedef bool (*console_recogniser_func)(char* cmd);
 
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+// Largest reply to a binary frame, with the whole stack.
+#ifdef CONSOLE_FRAME_CRC
+#define CONSOLE_FRAME_REPLY_SIZE (CONSOLE_DATA_STACK_SIZE * CONSOLE_CELL_SIZE + 7)		// Char, length, length check, sequence, status, stack & CRC.
+#else
+#define CONSOLE_FRAME_REPLY_SIZE (CONSOLE_DATA_STACK_SIZE * CONSOLE_CELL_SIZE + 3)		// Char, length, status & stack.
+#endif
+#endif
+#if defined(CONSOLE_FRAME_CRC) && !defined(CONSOLE_BINARY_FRAME_CHAR)
+#error CONSOLE_FRAME_CRC needs CONSOLE_BINARY_FRAME_CHAR
+#endif
+#if defined(CONSOLE_FRAME_REPLAY) && !defined(CONSOLE_FRAME_CRC)
+#error CONSOLE_FRAME_REPLAY needs CONSOLE_FRAME_CRC
+#endif
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+// Size of each upload chunk taken by consoleAcceptIsr(), the double buffers are made large enough to hold it.
+#ifndef CONSOLE_BULK_CHUNK_SIZE
+#define CONSOLE_BULK_CHUNK_SIZE CONSOLE_INPUT_BUFFER_SIZE
+#endif
+#if (CONSOLE_BULK_CHUNK_SIZE) > 255
+#error CONSOLE_BULK_CHUNK_SIZE is at most 255 as chunk sizes are a console_small_uint_t
+#endif
+#if (CONSOLE_BULK_CHUNK_SIZE) > (CONSOLE_INPUT_BUFFER_SIZE)
+#define CONSOLE_ACCEPT_DOUBLE_SIZE CONSOLE_BULK_CHUNK_SIZE
+#else
+#define CONSOLE_ACCEPT_DOUBLE_SIZE CONSOLE_INPUT_BUFFER_SIZE
+#endif
+#endif
+
+#ifdef CONSOLE_TASKS
+#if !defined(CONSOLE_TASK_LINE_SIZE) || !defined(CONSOLE_TASK_STACK_SIZE)
+#error CONSOLE_TASKS needs CONSOLE_TASK_LINE_SIZE & CONSOLE_TASK_STACK_SIZE
+#endif
+
+// A background task, a line run every period ms, or once if the period is zero. The slot is free if the line is empty.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"			// The line may leave the struct short of its alignment.
+typedef struct {
+	uint32_t due;									// Time of the next run in ms.
+	uint32_t period;
+	console_int_t stack[CONSOLE_TASK_STACK_SIZE];	// The task's own stack, kept between runs.
+	uint8_t depth;
+	char line[CONSOLE_TASK_LINE_SIZE];
+} console_task_t;
+#pragma GCC diagnostic pop
+#endif // CONSOLE_TASKS
+
+// Struct to hold the console interpreter's state.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"			// The yield state may leave a gap before the next pointer.
+typedef struct {
+	console_int_t dstack[CONSOLE_DATA_STACK_SIZE];	// Our stack, grows down in memory.
+	console_int_t* sp;								// Stack pointer, points to topmost item.
+	jmp_buf jmpbuf;									// How we do aborts.
+#ifdef CONSOLE_ADDRESS_HANDLES
+	const void* addrs[CONSOLE_ADDRESS_TABLE_SIZE];	// Addresses pushed on the current line, a handle is the index plus one.
+	const void** ap;								// Points to next free entry in addrs.
+#endif
+#ifdef CONSOLE_SCRATCH_SIZE
+	char* scratch_p;								// Next free byte in scratch.
+#endif
+#ifdef CONSOLE_STRING_HEAP_SIZE
+	char* heap_p;									// Next free byte in heap.
+#endif
+#ifdef CONSOLE_PROCESS_STEP
+	char* step_line;								// Line being run by consoleProcessStep().
+	char* step_p;									// Next char to parse in the line.
+	char* yield_cmd;								// Command that yielded, it is called again before the rest of the line.
+	console_int_t yield_state;						// Set by the command when it yields, zero when it is first called.
+#endif
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	uint16_t frame_hash;							// Hash of the command in the frame being run.
+#endif
+#ifdef CONSOLE_FRAME_REPLAY
+	uint16_t replay_crc[CONSOLE_FRAME_REPLAY];		// CRC of the frame each reply answers, so a new frame that reuses a sequence number is run.
+	uint8_t replay[CONSOLE_FRAME_REPLAY][CONSOLE_FRAME_REPLY_SIZE];	// Last replies sent, a free entry has a zero length.
+	console_small_uint_t replay_next;				// Entry to use next, the oldest.
+#endif
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+	volatile bool abort_req;						// Set by consoleAbort(), maybe from an ISR, cleared when a line starts.
+#endif
+#ifdef CONSOLE_TASKS
+	char* line_rest;								// Rest of the line after the command being run.
+	console_task_t* task_running;					// Task being run, cleared if it is killed so that its stack is not saved.
+	uint32_t task_now;								// Time given to the last call of consoleServiceTasks() or consoleTasksWait().
+	console_task_t tasks[CONSOLE_TASKS];
+#endif
+#if defined(CONSOLE_OUTPUT_SHARE_INPUT_BUFFER) && !defined(CONSOLE_SCRATCH_SIZE)
+	char* pin;										// First string decoded in place on this line, output may not be staged over it.
+#endif
+#ifdef CONSOLE_SCRATCH_SIZE
+	char scratch[CONSOLE_SCRATCH_SIZE];				// Arena for string literals, reset by consoleProcess().
+#endif
+#ifdef CONSOLE_STRING_HEAP_SIZE
+	char heap[CONSOLE_STRING_HEAP_SIZE];			// Strings that outlive their line.
+#endif
+} console_context_t;
+#pragma GCC diagnostic pop
+
+#if defined(CONSOLE_DEFINE_PRINT) && (defined(CONSOLE_OUTPUT_BUFFER_SIZE) || defined(CONSOLE_OUTPUT_SHARE_INPUT_BUFFER))
+/* Output buffer, written with CONSOLE_OUTPUT_WRITE() on a newline or when full. If the input buffer is shared the buffer is the part of the line 
+	that consoleProcess() has consumed, outside consoleProcess() it is empty and output is written directly. */
+typedef struct {
+	char* p;										// Next free char in buffer.
+	char* start;
+	char* end;
+#ifdef CONSOLE_OUTPUT_BUFFER_SIZE
+	char buf[CONSOLE_OUTPUT_BUFFER_SIZE];
+#endif
+} console_output_context_t;
+#define CONSOLE_HAVE_OUTPUT_CONTEXT
+#endif
+
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+// State of receiving a binary frame into a line buffer, its length is held in the first byte of the buffer.
+typedef struct {
+	console_small_uint_t state;
+	console_small_uint_t left;						// Bytes of the frame still to come once the length is known.
+} console_frame_rx_t;
+#endif
+
+#ifdef CONSOLE_BULK_ACK_CHAR
+// Sink for a bulk upload, see consoleSetBulkSink().
+typedef void (*console_bulk_sink_func)(const uint8_t* buf, console_small_uint_t n);
+#endif
+
+// State for consoleAccept().
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"			// The buffer may leave the struct short of the alignment of the upload count.
+typedef struct {
+#ifdef CONSOLE_BULK_ACK_CHAR
+	console_bulk_sink_func bulk_sink;
+	uint32_t bulk_left;								// Bytes of an upload still to come, they are collected in inbuf.
+#endif
+	char inbuf[CONSOLE_INPUT_BUFFER_SIZE + 1];
+	console_small_uint_t inbidx;
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	console_frame_rx_t frame;
+#endif
+} console_accept_context_t;
+#pragma GCC diagnostic pop
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+/* State for consoleAcceptIsr() & consoleAcceptLine(). One buffer is filled by the ISR while the other holds a completed line for the main loop,
+	so the next line can be received while the last one runs. The ISR only swaps buffers when the other is free & the main loop only moves it
+	on from ready or taken, so no locking is needed on a single core part. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"			// The buffers may leave the struct short of the alignment of the upload counts.
+typedef struct {
+#ifdef CONSOLE_BULK_ACK_CHAR
+	uint32_t bulk_pending;							// Upload asked for by the line being run, started by consoleAcceptLine() when it is released.
+	uint32_t bulk_left;								// Bytes of an upload still to come, only used by the ISR once bulk is set.
+#endif
+	char inbuf[2][CONSOLE_ACCEPT_DOUBLE_SIZE + 1];
+	console_small_uint_t inbidx;
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	console_frame_rx_t frame;						// Frames are received into the buffer being filled like lines.
+#endif
+	volatile console_small_uint_t fill;				// Index of buffer being filled by the ISR.
+	volatile console_small_uint_t state;			// State of the other buffer.
+	volatile console_small_int_t rc;				// Status of the ready line from accept_char(), a console_rc_t.
+	volatile bool lost;								// A line arrived while the other buffer was still in use.
+#ifdef CONSOLE_BULK_ACK_CHAR
+	volatile bool bulk;								// Input is an upload, taken raw.
+	volatile console_small_uint_t bulk_n;			// Size of the ready chunk of an upload, zero if it is a line.
+#endif
+} console_accept_double_context_t;
+#pragma GCC diagnostic pop
+#endif // CONSOLE_ACCEPT_DOUBLE_BUFFER
+
+#ifdef CONSOLE_MULTI_CONTEXT
+/* With CONSOLE_MULTI_CONTEXT there may be any number of consoles, each with its own stack, error jump target, accept & output buffers, double 
+	buffered accept, bulk sink & tasks. All the 
+	console functions work on the current console, which is held in a CONSOLE_THREAD_LOCAL variable, so recognisers can use console_u_*() as usual.
+	Until consoleSetContext() is called the current console is a default one. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"			// The accept buffer may leave the struct short of its alignment.
+typedef struct {
+	console_context_t ctx;
+#ifdef CONSOLE_HAVE_OUTPUT_CONTEXT
+	console_output_context_t output;
+#endif
+	void* user;										// For the application, e.g. to find where CONSOLE_OUTPUT_WRITE() should write.
+	console_accept_context_t accept;
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+	console_accept_double_context_t accept_double;
+#endif
+} console_t;
+#pragma GCC diagnostic pop
+#endif // CONSOLE_MULTI_CONTEXT
+
 /* Initialise the console .  */
 void consoleInit(void);
 
@@ -33,7 +242,16 @@ enum {
 	CONSOLE_PRINT_NO_LEAD = 0x40,	// AND with option to _NOT_ print some leading characters.
 	CONSOLE_PRINT_NO_SEP = 0x80	// AND with option to _NOT_ print a trailing space.
 };
-void consolePrint(console_small_uint_t opt, console_int_t x);
+void consolePrint(console_small_uint_t opt, console_arg_t x);
+
+/* Format a number option for consolePrint() backwards from end, including the lead char & separator, returning a pointer to the first char. 
+	NULL is returned if opt is not a number. The buffer must be at least CONSOLE_FORMAT_BUFFER_SIZE chars, no nul is written. */
+#define CONSOLE_FORMAT_BUFFER_SIZE (CONSOLE_CELL_SIZE * 3 + 2)
+char* consoleFormatNumber(char* end, console_small_uint_t opt, console_arg_t x);
+
+/* If output is buffered, write any buffered output. This happens anyway when a newline is printed or the buffer is full, so only needs to be 
+	called to write a partial line, e.g. a prompt. Does nothing if output is not buffered. */
+void consoleOutputFlush(void);
 
 // Prototypes for various recogniser functions.
 
@@ -62,6 +280,18 @@ bool console_cmds_example(char* cmd);
 // Optional help commands, will be empty if CONSOLE_WANT_HELP not defined.
 bool console_cmds_help(char* cmd);
 
+// Commands for the string heap, only defined if CONSOLE_STRING_HEAP_SIZE is defined.
+bool console_cmds_keep(char* cmd);
+
+// Commands for background tasks, only defined if CONSOLE_TASKS is defined.
+bool console_cmds_tasks(char* cmd);
+
+// Commands for bulk upload, only defined if CONSOLE_BULK_ACK_CHAR is defined.
+bool console_cmds_bulk(char* cmd);
+
+// Commands to dump memory, only defined if CONSOLE_WANT_DUMP is defined.
+bool console_cmds_dump(char* cmd);
+
 /* Define possible error codes. The convention is that positive codes are actual errors, zero is OK, and negative
 	values are more like status codes that do not indicate an error.
 	Errors are defined with an X macro as they have associated text. They will have codes increasing from 1. */
@@ -73,7 +303,12 @@ bool console_cmds_help(char* cmd);
 	X(ACC_OVF, 		"input buffer overflow")													\
 	X(BAD_IDX, 		"index out of range")															\
 	X(BAD_CMD, 		"unknown command")																\
-	X(DIV_ZERO, 	"divide by zero")
+	X(DIV_ZERO, 	"divide by zero")																\
+	X(ADDR_OVF, 	"too many addresses")															\
+	X(MEM_OVF, 		"out of memory")																\
+	X(ABORTED, 		"aborted")																\
+	X(BAD_FRAME, 	"bad frame")																\
+	X(BAD_CRC, 		"bad CRC")
 
 #define CONSOLE_DEF_ERROR_CODE_ENUM(v_, s_) CONSOLE_RC_ERR_ ## v_,
 enum {
@@ -88,7 +323,10 @@ enum {
 	CONSOLE_RC_STAT_IGN_EOL =		-1,		// Internal signal used to implement comments.
 	CONSOLE_RC_STAT_ACC_PEND =	-2,		// Only returned by consoleAccept() to signal that it is still accepting characters.
 	CONSOLE_RC_STAT_ACC_CAN = 	-3,		// Only returned by consoleAccept() to signal input cancelled.
-	CONSOLE_RC_STAT_USER =			-4		// Status codes available for the user.
+	CONSOLE_RC_STAT_PROC_PEND =	-4,		// Only returned by consoleProcessStep() to signal that the line has more to run.
+	CONSOLE_RC_STAT_YIELD =		-5,		// Internal signal used by console_yield().
+	CONSOLE_RC_STAT_ACC_FRAME =	-6,		// Only returned by consoleAccept() to signal that a binary frame is complete.
+	CONSOLE_RC_STAT_USER =			-7		// Status codes available for the user.
 };
 #undef CONSOLE_DEF_ERROR_CODE_ENUM
 
@@ -103,6 +341,44 @@ const char* consoleGetErrorDescription(console_rc_t err);
 	If pointer current supplied it is set to command in the input buffer that has been executed. */
 console_rc_t consoleProcess(char* str, const char** current);
 
+#ifdef CONSOLE_PROCESS_STEP
+/* Run a line a few commands at a time, so that a long line does not hold up the caller. consoleProcessBegin() starts the line, which must stay 
+	unchanged until it is done, then each call to consoleProcessStep() runs up to max_tokens commands, or all of them if zero. It returns 
+	CONSOLE_RC_STAT_PROC_PEND while the line has more to run, otherwise as consoleProcess(). The stack is kept between calls as usual. If current 
+	is supplied it is set to the failing command on an error, as for consoleProcess(), and to the command that yielded if one did. */
+void consoleProcessBegin(char* str);
+console_rc_t consoleProcessStep(console_small_uint_t max_tokens, const char** current);
+#endif
+
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+/* Run a binary frame, as received by consoleAccept() when it returns CONSOLE_RC_STAT_ACC_FRAME. The frame is its length, then the count of 
+	cells, the cells little-endian which are pushed, then optionally a command as its 16 bit hash little-endian, which is run by the recognisers 
+	as if it had been typed. The reply is CONSOLE_BINARY_FRAME_CHAR, its length, the status, then the stack bottom first little-endian, which is 
+	then emptied. Any text output from the command comes before the reply. Returns the status as consoleProcess(). */
+console_rc_t consoleProcessFrame(const char* frame);
+
+#ifdef CONSOLE_FRAME_CRC
+/* With CONSOLE_FRAME_CRC the frame char is followed by the length, its complement, then a sequence number, the frame as above & a CRC-16 of 
+	the sequence number & frame, low byte first. The reply is the same, with the sequence number of the frame it answers. A frame with a bad CRC
+	is not run & gets the status CONSOLE_RC_ERR_BAD_CRC. A bad length complement drops input until the next frame char or newline, so no reply. 
+	With CONSOLE_FRAME_REPLAY the last replies are kept, & a frame with the sequence number & CRC of the one a reply answered is answered with it 
+	& not run again. Replies to bad frames are not kept, so one sent again is checked afresh. */
+uint16_t console_crc16(const void* p, size_t n);
+#endif
+#endif
+
+#ifdef CONSOLE_TASKS
+/* Run the background tasks that are due at time now in ms, which may wrap. Each task's output is tagged `[id] ' & ends with a newline, a task 
+	that errors prints the error & is removed. A periodic task that falls more than a period behind skips the runs it missed. Returns the 
+	number of tasks run. Do not call while a line is being run by consoleProcessStep(). */
+console_small_uint_t consoleServiceTasks(uint32_t now);
+
+/* Returns the time in ms from now until the next task is due, zero if one is due already, or CONSOLE_TASKS_IDLE if there are none. Both
+	functions record now, EVERY & AFTER schedule from the last time recorded. */
+#define CONSOLE_TASKS_IDLE ((uint32_t)0xffffffffUL)
+uint32_t consoleTasksWait(uint32_t now);
+#endif
+
 // Input functions, may be helpful.
 
 /* Resets the state of accept to what it was after calling consoleInit(), or after consoleAccept() has read a newline
@@ -111,14 +387,142 @@ void consoleAcceptClear(void);
 
 /* Read chars into a buffer, returning CONSOLE_ERROR_ACCEPT_PENDING. Only CONSOLE_INPUT_BUFFER_SIZE chars are stored.
 	If the character CONSOLE_INPUT_NEWLINE_CHAR is seen, then return CONSOLE_RC_OK if no overflow, else CONSOLE_ERROR_INPUT_OVERFLOW.
-	In either case the buffer is nul terminated, but not all chars will have been stored on overflow. */
+	In either case the buffer is nul terminated, but not all chars will have been stored on overflow. 
+	With CONSOLE_BINARY_FRAME_CHAR that char at the start of a line begins a binary frame, the next byte is its length. When it is complete 
+	CONSOLE_RC_STAT_ACC_FRAME is returned & the buffer holds the frame for consoleProcessFrame(), or CONSOLE_RC_ERR_ACC_OVF if it was too long. */
 console_rc_t consoleAccept(char c);
 
+#ifdef CONSOLE_BULK_ACK_CHAR
+/* Bulk upload, `u UPLOAD' makes consoleAccept() take the next u bytes after its line raw, with no parsing, into the idle accept buffer. It 
+	prints CONSOLE_BULK_ACK_CHAR when ready, then each time the buffer is full, and at the end, the bytes are passed to the sink & the ack is 
+	printed again for flow control. The host sends the next CONSOLE_INPUT_BUFFER_SIZE bytes on each ack, and may keep one chunk ahead if the 
+	input stream can hold it. A slow sink, e.g. writing flash, delays the ack. Each console has one sink, set on the current console, UPLOAD 
+	raises BAD_IDX if it is not set. If the line came from consoleAcceptLine() the upload is taken raw by consoleAcceptIsr() instead, starting 
+	when the line is released by the next call to consoleAcceptLine(), which passes each chunk to the sink. There chunks are 
+	CONSOLE_BULK_CHUNK_SIZE bytes & the host must wait for each ack. */
+void consoleSetBulkSink(console_bulk_sink_func sink);
+#endif
+
+#ifdef CONSOLE_MULTI_CONTEXT
+// Set the current console, it must have been initialised with consoleInitContext().
+void consoleSetContext(console_t* con);
+console_t* consoleGetContext(void);
+
+// Initialise a console and make it current.
+void consoleInitContext(console_t* con, void* user);
+
+// As consoleProcess() & consoleAccept() on the given console, which is left current.
+console_rc_t consoleProcessContext(console_t* con, char* str, const char** current);
+console_rc_t consoleAcceptContext(console_t* con, char c);
+#endif // CONSOLE_MULTI_CONTEXT
+
+#ifdef CONSOLE_MULTITASK
+#if !defined(CONSOLE_MULTI_CONTEXT) || !defined(CONSOLE_PROCESS_STEP)
+#error CONSOLE_MULTITASK needs CONSOLE_MULTI_CONTEXT & CONSOLE_PROCESS_STEP
+#endif
+
+/* Task control block for the multitasker, each task runs a script in its own console. The RAM cost per task is sizeof(console_tcb_t), which
+	is a console_t plus two pointers & a flag, as the line being run is held in the console's idle accept buffer. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+typedef struct {
+	console_t con;
+	const char* script;								// Lines separated by newlines, NULL if the block is free.
+	const char* next;								// Start of the next line to run.
+	bool repeat;									// Run the script again from the start when it ends.
+} console_tcb_t;
+#pragma GCC diagnostic pop
+
+/* Start a task running a script, which is not copied so must outlive the task, with user as for consoleInitContext(). A repeating task is like
+	a FORTH task's endless loop. Returns NULL if CONSOLE_MULTITASK tasks are running. */
+console_tcb_t* consoleMultitaskSpawn(const char* script, bool repeat, void* user);
+
+// Stop a task, it may be called from the task itself.
+void consoleMultitaskStop(console_tcb_t* t);
+
+/* Run the next task in turn until it gives way at PAUSE or at the end of a line, then the console that was current is current again. Returns 
+	CONSOLE_RC_STAT_PROC_PEND if the task paused, else as consoleProcess() for the line, a task whose line errors is stopped. *task is set to the 
+	task that ran, or NULL if there are none. Output from the task is flushed before returning. */
+console_rc_t consoleMultitaskRun(console_tcb_t** task, const char** current);
+#endif // CONSOLE_MULTITASK
+
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+/* Ask the current console to stop the line it is running, it is raised as CONSOLE_RC_ERR_ABORTED at the next safe point. It only sets a flag, so
+	may be called from an ISR or signal handler when CONSOLE_INPUT_ABORT_CHAR is received. */
+void consoleAbort(void);
+#ifdef CONSOLE_MULTI_CONTEXT
+void consoleAbortContext(console_t* con);
+#endif
+#endif // CONSOLE_INPUT_ABORT_CHAR
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+/* Double buffered accept, for feeding input from an interrupt. consoleAcceptIsr() is called from the ISR for each char. consoleAcceptLine() is 
+	called from the main loop, it returns CONSOLE_RC_STAT_ACC_PEND until a line is complete, then returns as consoleAccept() would with line set to 
+	the buffer. The line stays valid until the next call, meanwhile the next line is received into the other buffer. If a line completes before 
+	the last one is released it is dropped and CONSOLE_RC_ERR_ACC_OVF is returned with an empty line. Binary frames are received as by 
+	consoleAccept(), & a complete one is returned as CONSOLE_RC_STAT_ACC_FRAME for consoleProcessFrame(). consoleAcceptIsr() returns true if the
+	char was taken as binary data, in a frame or an upload, so the ISR knows not to look at it for an abort char. Both work on the current 
+	console, with CONSOLE_MULTI_CONTEXT the ISR must use consoleAcceptIsrContext() as the current console is set by the main loop. */
+bool consoleAcceptIsr(char c);
+console_rc_t consoleAcceptLine(char** line);
+#ifdef CONSOLE_MULTI_CONTEXT
+bool consoleAcceptIsrContext(console_t* con, char c);
+#endif
+#endif // CONSOLE_ACCEPT_DOUBLE_BUFFER
+
+#ifdef CONSOLE_QUEUE_SIZE
+#if CONSOLE_QUEUE_SIZE <= 256
+typedef uint8_t console_queue_index_t;
+#elif CONSOLE_QUEUE_SIZE <= 65536
+typedef uint16_t console_queue_index_t;
+#else
+typedef uint32_t console_queue_index_t;
+#endif
+
+/* Lock-free single producer single consumer byte queue. Each index is only written by one side, and is published after the data it covers, so 
+	the producer & consumer may be on different threads, or one may be an ISR, with no locks. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"			// The buffer may leave the struct short of its alignment.
+typedef struct {
+	console_queue_index_t head;						// Next free slot, only written by the producer.
+	console_queue_index_t tail;						// Next char to read, only written by the consumer.
+	char buf[CONSOLE_QUEUE_SIZE];
+} console_queue_t;
+#pragma GCC diagnostic pop
+
+// Empty a queue, only call when neither side is using it.
+void consoleQueueInit(console_queue_t* q);
+
+// Producer, writes as many chars as there is room for & returns the count written.
+size_t consoleQueueWrite(console_queue_t* q, const char* buf, size_t n);
+
+// Consumer, reads up to n chars & returns the count read.
+size_t consoleQueueRead(console_queue_t* q, char* buf, size_t n);
+
+/* Consumer, accepts chars from the queue until a line is complete then processes it, returning as consoleProcess(), or as consoleAccept() on an 
+	accept error. Returns CONSOLE_RC_STAT_ACC_PEND if the queue empties first, the partial line is kept for the next call. Chars are released 
+	back to the producer before the line is run. */
+console_rc_t consoleServiceQueue(console_queue_t* q, const char** current);
+#endif // CONSOLE_QUEUE_SIZE
+
 // Followint functions are for implementing commands. Do not use unless in a recogniser function called by the console.
 
 // Call on error, thanks to the magic of longjmp() it will return to the last setjmp with the error code.
 void console_raise(console_rc_t rc);
 
+#ifdef CONSOLE_PROCESS_STEP
+/* For commands that take a long time, they can do some of the work, then call console_yield() to return from consoleProcessStep(). The command
+	is called again on the next step & console_yield_state() returns the state it gave, it is zero when the command is first called. So state 
+	must be non-zero, and anything else kept on the stack. consoleProcess() calls the command again at once. */
+void console_yield(console_int_t state);
+console_int_t console_yield_state(void);
+#endif
+
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+// Raise CONSOLE_RC_ERR_ABORTED if consoleAbort() has been called, for commands that loop to call at a safe point. It is called between commands.
+void console_poll_abort(void);
+#endif
+
 // Error handling in commands.
 void console_verify_can_pop(console_small_uint_t n);
 void console_verify_can_push(console_small_uint_t n);
@@ -135,14 +539,32 @@ console_int_t console_u_pop(void);
 void console_u_push(console_int_t x);
 void console_u_clear(void);
 
+/* Addresses are pushed on the stack with console_u_push_ptr() and read back with console_cell_to_ptr(). If a cell can hold a pointer these are
+	just casts. Otherwise the cell holds a handle that is only valid until the next call of consoleProcess(), and the conversions may raise. */
+#ifdef CONSOLE_ADDRESS_HANDLES
+console_int_t console_ptr_to_cell(const void* p);
+void* console_cell_to_ptr(console_int_t x);
+#else
+#define console_ptr_to_cell(p_) ((console_int_t)(uintptr_t)(p_))
+#define console_cell_to_ptr(x_) ((void*)(uintptr_t)(x_))
+#endif
+#define console_u_push_ptr(p_) console_u_push(console_ptr_to_cell(p_))
+#define console_u_pop_ptr() console_cell_to_ptr(console_u_pop())
+
+// Allocate memory from the scratch arena that is valid until the next call of consoleProcess(). Raises on overflow.
+void* console_scratch_alloc(size_t n);
+
+// Copy data into the string heap, returning the address of the copy. Raises on overflow.
+void* console_keep(const void* p, size_t n);
+
 /* Some helper macros for commands. */
-#define console_binop(op_)	{ const console_int_t rhs = console_u_pop(); console_u_tos() = console_u_tos() op_ rhs; } 	// Implement a signed binary operator.
+#define console_binop(op_)	{ const console_int_t rhs = console_u_pop(); console_u_tos() = (console_int_t)(console_u_tos() op_ rhs); } 	// Implement a signed binary operator.
 #define console_u_binop(op_)	{ \
   const console_uint_t rhs = (console_uint_t)console_u_pop(); \
   console_u_tos() = (console_int_t)((console_uint_t)console_u_tos() op_ rhs);	\
 } 	// Implement an unsigned binary operator.
 #define console_u_unop(op_)	{ console_u_tos() = (console_int_t)(op_ (console_uint_t)console_u_tos()); }											// Implement a signed unary operator.
-#define console_unop(op_)	{ console_u_tos() = op_ console_u_tos(); }											// Implement a signed unary operator.
+#define console_unop(op_)	{ console_u_tos() = (console_int_t)(op_ console_u_tos()); }											// Implement a signed unary operator.
 
 // Following functions are exposed for testing only.
 //
@@ -7,81 +7,603 @@
 #include <Stream.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
 // Single instance of Arduino console. Poor man's Singleton, don't create more than one.
 _FConsole FConsole;
 
+// FConsole buffers output per stream itself, so output cannot be staged in the console's input buffer.
+#ifdef CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+#error FConsole does not support CONSOLE_OUTPUT_SHARE_INPUT_BUFFER, use CONSOLE_OUTPUT_BUFFER_SIZE or CONSOLE_TX_QUEUE_SIZE
+#endif
+
+#ifndef CONSOLE_SERVICE_BYTE_BUDGET
+#define CONSOLE_SERVICE_BYTE_BUDGET 32
+#endif
+#if defined(CONSOLE_PROCESS_STEP) && !defined(CONSOLE_SERVICE_TOKEN_BUDGET)
+#define CONSOLE_SERVICE_TOKEN_BUDGET 8
+#endif
+
+#if defined(CONSOLE_TX_QUEUE_SIZE)
+#ifndef CONSOLE_TX_QUEUE_POLICY
+#define CONSOLE_TX_QUEUE_POLICY CONSOLE_TX_QUEUE_TRUNCATE
+#endif
+#ifndef CONSOLE_TX_QUEUE_MARKER
+#define CONSOLE_TX_QUEUE_MARKER "~"
+#endif
+
+/* Output is queued in a ring buffer and drained by drain() only as far as the stream can take without blocking. Space for the truncation
+	marker & a newline is held back so a truncated line always ends with both. */
+class TxQueue : public Print {
+public:
+	TxQueue() : _s(NULL), _head(0), _tail(0), _count(0), _truncated(false), _no_avail(false) {}
+	// An idle stream always has room, so one that says it has none does not implement availableForWrite().
+	void attach(Stream* s) { _s = s; _head = _tail = _count = 0; _truncated = false; _no_avail = (NULL != s) && (0 == s->availableForWrite()); }
+	virtual size_t write(uint8_t c) { return write(&c, 1); }
+	virtual size_t write(const uint8_t* b, size_t n) {
+		for (size_t i = 0; i < n; i += 1) {
+			if (_truncated)										// Rest of line is discarded.
+				break;
+			if (free() <= RESERVE) {
+#if CONSOLE_TX_QUEUE_POLICY == CONSOLE_TX_QUEUE_BLOCK
+				drain_blocking();
+#elif CONSOLE_TX_QUEUE_POLICY == CONSOLE_TX_QUEUE_DROP
+				break;
+#elif CONSOLE_TX_QUEUE_POLICY == CONSOLE_TX_QUEUE_TRUNCATE
+				push_str_p(PSTR(CONSOLE_TX_QUEUE_MARKER));
+				_truncated = true;
+				break;
+#else
+#error Unknown CONSOLE_TX_QUEUE_POLICY
+#endif
+			}
+			push(b[i]);
+		}
+		return n;
+	}
+	// A newline may use the reserved space & ends any truncation.
+	void newline() {
+		_truncated = false;
+#if CONSOLE_TX_QUEUE_POLICY == CONSOLE_TX_QUEUE_BLOCK
+		if (free() < sizeof(CONSOLE_OUTPUT_NEWLINE_STR) - 1)
+			drain_blocking();
+#endif
+		push_str_p(PSTR(CONSOLE_OUTPUT_NEWLINE_STR));
+	}
+	/* Write as much as the stream can take without blocking. A stream that does not implement availableForWrite() is written with write() as
+		if there were no queue, as there is no way to know how much it can take. */
+	void drain() {
+		if (!_s || _no_avail) {
+			drain_blocking();
+			return;
+		}
+		int avail = _s->availableForWrite();
+		while ((_count > 0) && (avail > 0)) {
+			const size_t n = write_chunk((size_t)avail);
+			avail -= (int)n;
+		}
+	}
+private:
+	typedef uint16_t index_t;
+	static const index_t SIZE = CONSOLE_TX_QUEUE_SIZE;
+	static const index_t RESERVE = sizeof(CONSOLE_TX_QUEUE_MARKER) - 1 + sizeof(CONSOLE_OUTPUT_NEWLINE_STR) - 1;
+
+	index_t free() const { return (index_t)(SIZE - _count); }
+	void push(uint8_t c) {
+		_buf[_head] = c;
+		if (++_head == SIZE)
+			_head = 0;
+		_count += 1;
+	}
+	void push_str_p(const char* s) {
+		uint8_t c;
+		while (('\0' != (c = pgm_read_byte(s++))) && (free() > 0))
+			push(c);
+	}
+	// Write the longest contiguous run up to max chars from the tail, returning the count written.
+	size_t write_chunk(size_t max) {
+		size_t n = (size_t)((_head > _tail) ? (_head - _tail) : (SIZE - _tail));
+		if (n > max)
+			n = max;
+		_s->write(&_buf[_tail], n);
+		_tail = (index_t)(_tail + n);
+		if (_tail == SIZE)
+			_tail = 0;
+		_count = (index_t)(_count - n);
+		return n;
+	}
+	void drain_blocking() {
+		if (!_s)
+			_head = _tail = _count = 0;
+		while (_count > 0)
+			write_chunk(SIZE);								// Stream write blocks until it has room.
+	}
+	Stream* _s;
+	index_t _head, _tail, _count;
+	bool _truncated;
+	bool _no_avail;											// Stream does not implement availableForWrite().
+	uint8_t _buf[CONSOLE_TX_QUEUE_SIZE];
+};
+typedef TxQueue Output;
+#elif defined(CONSOLE_OUTPUT_BUFFER_SIZE)
+/* Output is formatted into a buffer that is written to the stream with a single write on a newline, when it is full, and at the end of 
+	service(), rather than a write for every character. */
+class OutputBuffer : public Print {
+public:
+	OutputBuffer() : _s(NULL), _len(0) {}
+	void attach(Stream* s) { _s = s; _len = 0; }
+	virtual size_t write(uint8_t c) {
+		if (_len >= sizeof(_buf))
+			flush();
+		_buf[_len++] = c;
+		return 1;
+	}
+	virtual size_t write(const uint8_t* b, size_t n) {	// Block copy, the default writes one char at a time.
+		const size_t r = n;
+		while (n > 0) {
+			if (_len >= sizeof(_buf))
+				flush();
+			size_t chunk = sizeof(_buf) - _len;
+			if (chunk > n)
+				chunk = n;
+			memcpy(&_buf[_len], b, chunk);
+			_len += chunk; b += chunk; n -= chunk;
+		}
+		return r;
+	}
+	virtual void flush() {
+		if (_len && _s)
+			_s->write(_buf, _len);
+		_len = 0;
+	}
+private:
+	Stream* _s;
+	size_t _len;
+	uint8_t _buf[CONSOLE_OUTPUT_BUFFER_SIZE];
+};
+typedef OutputBuffer Output;
+#endif
+
+// Input is read from the stream in chunks into this buffer, any chars left after a line has been run are used on the next call to service().
+#define FCONSOLE_RX_CHUNK_SIZE 16
+
+// Each stream has its own console, output & input chunk buffer.
+struct FConsolePort {
+	Stream* stream;
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+	HardwareSerial* serial;							// Set if the stream is a HardwareSerial, so input can be read with readAvailable().
+#endif
+#ifdef CONSOLE_MULTI_CONTEXT
+	console_t con;
+#endif
+#if defined(CONSOLE_TX_QUEUE_SIZE) || defined(CONSOLE_OUTPUT_BUFFER_SIZE)
+	Output out;
+#endif
+	uint8_t rx_buf[FCONSOLE_RX_CHUNK_SIZE];
+	uint8_t rx_idx, rx_len;
+#ifdef CONSOLE_PROCESS_STEP
+	bool running;									// A line is part way through, no more input is accepted until it is done.
+	const char* cmd;								// Command that yielded or failed, in the line being run.
+#endif
+#ifdef CONSOLE_MACHINE_MODE
+	bool machine;									// No echo or prompt, replies are `seq output =status'.
+	bool switched;									// MACHINE changed the mode in the line being run.
+#endif
+};
+static FConsolePort f_ports[CONSOLE_FCONSOLE_STREAMS];
+static uint8_t f_nports;							// Count of streams in use.
+static uint8_t f_next;								// Port that service() starts with, so each gets a turn at going first.
+static FConsolePort* f_port;						// Current port, that output goes to.
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+static FConsolePort* f_isr_port;					// Port fed by the RX interrupt, if any.
+#endif
+
+#if defined(CONSOLE_TX_QUEUE_SIZE) || defined(CONSOLE_OUTPUT_BUFFER_SIZE)
+#define CONSOLE_OUT (f_port->out)
+#else
+#define CONSOLE_OUT (*FConsole.s_stream)
+#endif
+
+// Make a port current for both output & its console.
+static void select_port(FConsolePort* port) {
+	f_port = port;
+	FConsole.s_stream = port->stream;
+#ifdef CONSOLE_MULTI_CONTEXT
+	consoleSetContext(&port->con);
+#endif
+}
+
+// With a TX queue this only writes what the stream can take now, the rest is written by later calls to service().
+void consoleOutputFlush() {
+	if (!f_port)
+		return;
+#if defined(CONSOLE_TX_QUEUE_SIZE)
+	f_port->out.drain();
+#elif defined(CONSOLE_OUTPUT_BUFFER_SIZE)
+	f_port->out.flush();
+#endif
+}
+
+// Print a string in PROGMEM a chunk at a time, Print::print(const __FlashStringHelper*) writes a char at a time.
+static void print_str_p(const char* s) {
+	uint8_t buf[16];
+	uint8_t n;
+	do {
+		for (n = 0; n < sizeof(buf); n += 1) {
+			if ('\0' == (buf[n] = pgm_read_byte(s++)))
+				break;
+		}
+		CONSOLE_OUT.write(buf, n);
+	} while (n == sizeof(buf));
+}
+
 /* We have an Arduino print function that requires a Stream instance to print on. This is held in FConsole.
 	for testing you can set this in FConsole and not use any of its other functions. */
-void consolePrint(uint_least8_t opt, console_int_t x) {
-	if (FConsole.s_stream) {			// If an output stream has not been set do nothing.
+void consolePrint(uint_least8_t opt, console_arg_t x) {
+	if (f_port && FConsole.s_stream) {	// If an output stream has not been set do nothing.
+		char buf[CONSOLE_FORMAT_BUFFER_SIZE];
+		char* const end = &buf[sizeof(buf)];
+		const char* p = consoleFormatNumber(end, opt, x);
+		if (NULL != p) {				// Number with lead char & separator in one write.
+			CONSOLE_OUT.write((const uint8_t*)p, (size_t)(end - p));
+			return;
+		}
+
 		switch (opt & ~(CONSOLE_PRINT_NO_SEP|CONSOLE_PRINT_NO_LEAD)) {
-			case CONSOLE_PRINT_NEWLINE:		FConsole.s_stream->print(F(CONSOLE_OUTPUT_NEWLINE_STR)); (void)x; return; 	// No separator.
-			default:						(void)x; return;															// Ignore, print nothing.
-			case CONSOLE_PRINT_SIGNED:		FConsole.s_stream->print(x, DEC); break;
-			case CONSOLE_PRINT_UNSIGNED:	if (opt & CONSOLE_PRINT_NO_LEAD) FConsole.s_stream->print('+'); 
-											FConsole.s_stream->print((console_uint_t)x, DEC); break;
-			case CONSOLE_PRINT_HEX2:		if (opt & CONSOLE_PRINT_NO_LEAD) FConsole.s_stream->print('$');
-											if ((console_uint_t)x <= 0x0f) FConsole.s_stream->print(0);
-											FConsole.s_stream->print((console_uint_t)x & 0xffU, HEX); break;
-			case CONSOLE_PRINT_HEX:			if (opt & CONSOLE_PRINT_NO_LEAD) FConsole.s_stream->print('$');
-											for (console_uint_t m = 0xf; CONSOLE_UINT_MAX != m; m = (m << 4) | 0xf) {
-												if ((console_uint_t)x <= m)
-													FConsole.s_stream->print(0);
-											}
-											FConsole.s_stream->print((console_uint_t)x, HEX); break;
-			case CONSOLE_PRINT_STR:			FConsole.s_stream->print((const char*)x); break;
-			case CONSOLE_PRINT_STR_P:		FConsole.s_stream->print((const __FlashStringHelper*)x); break;
-			case CONSOLE_PRINT_CHAR:		FConsole.s_stream->print((char)x); break;
+#ifdef CONSOLE_TX_QUEUE_SIZE
+			case CONSOLE_PRINT_NEWLINE:		f_port->out.newline(); consoleOutputFlush(); return; 	// No separator.
+#else
+			case CONSOLE_PRINT_NEWLINE:		CONSOLE_OUT.print(F(CONSOLE_OUTPUT_NEWLINE_STR)); consoleOutputFlush(); return; 	// No separator.
+#endif
+			default:						return;															// Ignore, print nothing.
+			case CONSOLE_PRINT_STR:			CONSOLE_OUT.print((const char*)(uintptr_t)x); break;
+			case CONSOLE_PRINT_STR_P:		print_str_p((const char*)(uintptr_t)x); break;
+			case CONSOLE_PRINT_CHAR:		CONSOLE_OUT.print((char)x); break;
 		}
-		if (!(opt & CONSOLE_PRINT_NO_SEP))	FConsole.s_stream->print(' ');			// Print a space.
+		if (!(opt & CONSOLE_PRINT_NO_SEP))	CONSOLE_OUT.print(' ');			// Print a space.
 	}
 }
 
-static void print_console_seperator() { consolePrint(CONSOLE_PRINT_STR_P, (console_int_t)PSTR("->")); }
-
-/* The number & string recognisers must be before any recognisers that lookup using a hash, as numbers & strings
-	can have potentially any hash value so could look like commands. */
-static const console_recogniser_func RECOGNISERS[] PROGMEM = {
-	console_r_number_decimal,
-	console_r_number_hex,
-	console_r_string,
-	console_r_hex_string,
-	console_cmds_builtin,
-	_FConsole::r_cmds_user,			// Static member function, so it does not need a `this' pointer.
-	NULL
-};
+static void print_console_seperator() { consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(PSTR("->"))); }
 
 // Static members.
 console_recogniser_func _FConsole::s_r_user;
 Stream* _FConsole::s_stream;
 
+// Called by the console as one of CONSOLE_USER_RECOGNISERS, FConsole's own commands come first.
+bool fconsole_cmds_user(char* cmd) {
+#ifdef CONSOLE_MACHINE_MODE
+	switch (console_hash(cmd)) {
+		case /** MACHINE (f - ) Machine mode on this stream if f is non-zero, no echo or prompt & replies are `seq output =status'. **/ 0x0e00: {
+			const bool machine = (0 != console_u_pop());
+			if (machine != f_port->machine) {
+				f_port->machine = machine;
+				f_port->switched = true;
+			}
+		} return true;
+		default: break;
+	}
+#endif
+	return _FConsole::r_cmds_user(cmd);
+}
+
+// Add a port for a stream with a fresh console, and make it current.
+static FConsolePort* add_port(Stream& s) {
+	if (f_nports >= CONSOLE_FCONSOLE_STREAMS)
+		return NULL;
+	FConsolePort* const port = &f_ports[f_nports++];
+	port->stream = &s;
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+	port->serial = NULL;
+#endif
+#if defined(CONSOLE_TX_QUEUE_SIZE) || defined(CONSOLE_OUTPUT_BUFFER_SIZE)
+	port->out.attach(&s);
+#endif
+	port->rx_idx = port->rx_len = 0;
+#ifdef CONSOLE_PROCESS_STEP
+	port->running = false;
+	port->cmd = NULL;
+#endif
+#ifdef CONSOLE_MACHINE_MODE
+	port->machine = port->switched = false;
+#endif
+	select_port(port);
+#ifdef CONSOLE_MULTI_CONTEXT
+	consoleInitContext(&port->con, port);				// Setup console.
+#else
+	consoleInit();										// Setup console.
+#endif
+	return port;
+}
+
 void _FConsole::begin(console_recogniser_func r_user, Stream& s) {
 	s_r_user = r_user;									// Set user recogniser function.
-	s_stream = &s;										// Set stream for IO.
-	consoleInit(RECOGNISERS);							// Setup console.
+	f_nports = f_next = 0;								// Remove any previous streams.
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+	f_isr_port = NULL;
+#endif
+	add_port(s);
 }
+bool _FConsole::addStream(Stream& s) { return (NULL != add_port(s)); }
+
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+#if defined(CONSOLE_ACCEPT_DOUBLE_BUFFER) && defined(SERIAL_RX_HOOK)
+#ifdef CONSOLE_MULTI_CONTEXT
+#define accept_isr(c_) consoleAcceptIsrContext(&f_isr_port->con, (c_))	// The current console is whichever the main loop last set.
+#else
+#define accept_isr(c_) consoleAcceptIsr(c_)
+#endif
+static void rx_hook(unsigned char c) {
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+	if (CONSOLE_INPUT_ABORT_CHAR == (char)c) {			// Stop a running line at once, rather than after it is done...
+		if (accept_isr((char)c))						// Unless it is binary data in a frame.
+			return;
+#ifdef CONSOLE_MULTI_CONTEXT
+		consoleAbortContext(&f_isr_port->con);
+#else
+		consoleAbort();
+#endif
+		return;
+	}
+#endif
+	accept_isr((char)c);
+}
+#endif
+void _FConsole::begin(console_recogniser_func r_user, HardwareSerial& s) {
+	begin(r_user, (Stream&)s);
+	f_ports[0].serial = &s;
+#if defined(CONSOLE_ACCEPT_DOUBLE_BUFFER) && defined(SERIAL_RX_HOOK)
+	f_isr_port = &f_ports[0];							// There is only one pair of line buffers, so only this stream uses them.
+	if (!s.setRxHook(rx_hook))							// Core built without SERIAL_RX_HOOK, so input is read as usual.
+		f_isr_port = NULL;
+#endif
+}
+bool _FConsole::addStream(HardwareSerial& s) {
+	FConsolePort* const port = add_port(s);
+	if (port)
+		port->serial = &s;
+	return (NULL != port);
+}
+#endif
+
 void _FConsole::prompt() {
-	consolePrint(CONSOLE_PRINT_STR_P, (console_int_t)PSTR(CONSOLE_OUTPUT_NEWLINE_STR ">"));
+	consolePrint(CONSOLE_PRINT_NEWLINE, 0);				// Ends any truncated output line.
+	consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(PSTR(">")));
 }
 
-void _FConsole::service() {
-	if (FConsole.s_stream && (FConsole.s_stream->available())) {			// If a character is available...
-		const char c = FConsole.s_stream->read();
-		console_rc_t rc = consoleAccept(c);						// Add it to the input buffer.
-		if (rc >= CONSOLE_RC_OK) {								// On newline...
-			char* cmd = NULL;
-			consolePrint(CONSOLE_PRINT_STR, (console_int_t)consoleAcceptBuffer());	// Echo input line back to terminal.
-			print_console_seperator();							// Seperator string for output.
-			if (CONSOLE_RC_OK == rc)							// If accept has _NOT_ returned an error process the input...
-				rc = consoleProcess(consoleAcceptBuffer(), &cmd); // Process input string from input buffer filled by accept and record error code.
-			if (CONSOLE_RC_OK != rc) {							// If all went well then we get an OK status code
-				consolePrint(CONSOLE_PRINT_STR_P, (console_int_t)PSTR("Error:")); // Print error code:(
-				consolePrint(CONSOLE_PRINT_STR_P, (console_int_t)consoleGetErrorDescription(rc)); // Print description.
-				consolePrint(CONSOLE_PRINT_STR_P, (console_int_t)PSTR(":"));
-				consolePrint(CONSOLE_PRINT_SIGNED, (console_int_t)rc);
-			}
-			prompt();								// In any case print a newline and prompt ready for the next line of input.
+// Read up to n chars from the port's stream without waiting, returning the count read.
+static uint8_t read_input(FConsolePort* port, uint8_t* buf, uint8_t n) {
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+	if (port->serial)
+		return (uint8_t)port->serial->readAvailable(buf, n);
+#endif
+	const int avail = port->stream->available();
+	if (avail <= 0)
+		return 0;
+	if (avail < (int)n)
+		n = (uint8_t)avail;
+	return (uint8_t)port->stream->readBytes(buf, n);	// Chars are known to be available, so readBytes() will not wait for its timeout.
+}
+
+#ifdef CONSOLE_SERVICE_TIME_BUDGET_US
+#define time_budget_spent(start_) ((micros() - (start_)) >= (unsigned long)(CONSOLE_SERVICE_TIME_BUDGET_US))
+#endif
+
+// Print any error with the command that failed if known, then a prompt.
+static void end_line(console_rc_t rc, const char* cmd) {
+#ifdef CONSOLE_MACHINE_MODE
+	/* A line that switches mode is ended with the status in machine format either way, so a host always gets it. Leaving machine mode
+		the prompt follows. */
+	if (f_port->machine || f_port->switched) {			// Just the status to end the reply, & the failing command.
+		consolePrint(CONSOLE_PRINT_CHAR|CONSOLE_PRINT_NO_SEP, '=');
+		consolePrint(CONSOLE_PRINT_SIGNED|CONSOLE_PRINT_NO_SEP, (console_int_t)rc);
+		if ((CONSOLE_RC_OK != rc) && (NULL != cmd)) {
+			consolePrint(CONSOLE_PRINT_CHAR|CONSOLE_PRINT_NO_SEP, ' ');
+			consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(cmd));
+		}
+		consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+		if (!f_port->machine)
+			consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(PSTR(">")));
+		f_port->switched = false;
+		consoleOutputFlush();
+		return;
+	}
+#endif
+	if (CONSOLE_RC_OK != rc) {							// If all went well then we get an OK status code
+		if (NULL != cmd) {								// Error: `<cmd>': <description> : <code>
+			consolePrint(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, console_ptr_arg(PSTR("Error: `")));
+			consolePrint(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg(cmd));
+			consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(PSTR("':")));
 		}
+		else
+			consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(PSTR("Error:"))); // Print error code:(
+		consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(consoleGetErrorDescription(rc))); // Print description.
+		consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(PSTR(":")));
+		consolePrint(CONSOLE_PRINT_SIGNED, (console_int_t)rc);
+	}
+	FConsole.prompt();									// In any case print a newline and prompt ready for the next line of input.
+	consoleOutputFlush();								// Write the prompt, the rest was written on the newline.
+}
+
+#if defined(CONSOLE_PROCESS_STEP) && defined(CONSOLE_INPUT_ABORT_CHAR)
+/* While a line runs input is read ahead into the port's buffer, which is searched for the abort char, so one typed after the start of the next
+	line is still seen. The abort char is removed & the rest is left for when the line is done. Only as much input as fits in the buffer is 
+	searched, more may wait in the stream. */
+static void take_abort(FConsolePort* port) {
+	if (port->rx_idx > 0) {								// Make room at the end.
+		port->rx_len = (uint8_t)(port->rx_len - port->rx_idx);
+		memmove(port->rx_buf, &port->rx_buf[port->rx_idx], port->rx_len);
+		port->rx_idx = 0;
+	}
+	port->rx_len = (uint8_t)(port->rx_len + read_input(port, &port->rx_buf[port->rx_len], (uint8_t)(sizeof(port->rx_buf) - port->rx_len)));
+	uint8_t* const p = (uint8_t*)memchr(port->rx_buf, (uint8_t)CONSOLE_INPUT_ABORT_CHAR, port->rx_len);
+	if (NULL != p) {
+		port->rx_len -= 1;
+		memmove(p, p + 1, (size_t)(&port->rx_buf[port->rx_len] - p));
+		consoleAbort();
+	}
+}
+#endif
+
+#ifdef CONSOLE_PROCESS_STEP
+// Run up to the token budget of the line, or until the time budget is spent, and end it if it is done.
+static void step_line(FConsolePort* port, unsigned long start) {
+#ifdef CONSOLE_SERVICE_TIME_BUDGET_US
+	console_rc_t rc = CONSOLE_RC_STAT_PROC_PEND;
+	for (uint8_t tokens = 0; tokens < CONSOLE_SERVICE_TOKEN_BUDGET; tokens += 1) {
+		rc = consoleProcessStep(1, &port->cmd);
+		if ((CONSOLE_RC_STAT_PROC_PEND != rc) || time_budget_spent(start))
+			break;
+	}
+#else
+	const console_rc_t rc = consoleProcessStep(CONSOLE_SERVICE_TOKEN_BUDGET, &port->cmd);
+	(void)start;
+#endif
+	if (CONSOLE_RC_STAT_PROC_PEND != rc) {
+		port->running = false;
+		end_line(rc, port->cmd);
+	}
+	else
+		consoleOutputFlush();							// Show progress.
+}
+#endif // CONSOLE_PROCESS_STEP
+
+#ifdef CONSOLE_MACHINE_MODE
+// Print the sequence number that starts the line, if any, to start the reply & return the rest of the line.
+static char* machine_seq(char* line) {
+	while (' ' == *line)
+		line += 1;
+	char* p = line;
+	while ((*p >= '0') && (*p <= '9'))
+		p += 1;
+	if ((p == line) || ((' ' != *p) && ('\0' != *p)))	// Not a sequence number, so part of the line.
+		return line;
+	if ('\0' != *p)
+		*p++ = '\0';
+	consolePrint(CONSOLE_PRINT_STR, console_ptr_arg(line));
+	return p;
+}
+#endif
+
+static void run_line(FConsolePort* port, console_rc_t rc, char* line, unsigned long start) {
+#ifdef CONSOLE_MACHINE_MODE
+	if (port->machine)
+		line = machine_seq(line);
+	else
+#endif
+	{
+		consolePrint(CONSOLE_PRINT_STR, console_ptr_arg(line));	// Echo input line back to terminal.
+		print_console_seperator();						// Seperator string for output.
+	}
+	if (CONSOLE_RC_OK == rc) {							// If accept has _NOT_ returned an error process the input...
+#ifdef CONSOLE_PROCESS_STEP
+		consoleProcessBegin(line);						// Run the line a few commands at a time from service().
+		port->running = true;
+		port->cmd = NULL;
+		step_line(port, start);
+		return;
+#else
+		const char* cmd = NULL;
+		rc = consoleProcess(line, &cmd); // Process input string from input buffer filled by accept and record error code.
+		end_line(rc, cmd);
+		return;
+#endif
+	}
+	(void)port; (void)start;
+	end_line(rc, NULL);
+}
+
+/* Accept available input on a port up to the byte budget, or the time budget if set, but return after running a line so that the time spent
+	on one port is bounded. */
+static void service_port(FConsolePort* port, unsigned long start) {
+	select_port(port);
+	consoleOutputFlush();									// Drain any queued output.
+
+#ifdef CONSOLE_PROCESS_STEP
+	if (port->running) {									// Input waits in the stream until the line is done.
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+		take_abort(port);
+#endif
+		step_line(port, start);
+		return;
+	}
+#endif
+
+#ifdef CONSOLE_TASKS
+	if (consoleServiceTasks(millis()) > 0) {				// Background tasks run between lines, their output ends with a newline.
+#ifdef CONSOLE_MACHINE_MODE
+		if (!port->machine)
+#endif
+			consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg(PSTR(">")));
+		consoleOutputFlush();
+	}
+#endif
+
+#if defined(CONSOLE_ACCEPT_DOUBLE_BUFFER) && defined(HAVE_HWSERIAL_READ_AVAILABLE)
+	if (port == f_isr_port) {
+		char* line;
+		const console_rc_t rc = consoleAcceptLine(&line);	// Line received by the RX interrupt.
+		if (rc >= CONSOLE_RC_OK)
+			run_line(port, rc, line, start);
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+		else if (CONSOLE_RC_STAT_ACC_FRAME == rc)
+			consoleProcessFrame(line);
+#endif
+		return;
+	}
+#endif
+
+	uint16_t budget = CONSOLE_SERVICE_BYTE_BUDGET;
+	while (budget > 0) {
+		if (port->rx_idx >= port->rx_len) {					// Refill from stream.
+			const uint8_t n = (budget < sizeof(port->rx_buf)) ? (uint8_t)budget : (uint8_t)sizeof(port->rx_buf);
+			port->rx_idx = 0;
+			port->rx_len = read_input(port, port->rx_buf, n);
+			if (0 == port->rx_len)
+				break;
+		}
+		budget -= 1;
+		const console_rc_t rc = consoleAccept((char)port->rx_buf[port->rx_idx++]);	// Add it to the input buffer.
+		if (rc >= CONSOLE_RC_OK) {							// On newline run the line & return.
+			run_line(port, rc, consoleAcceptBuffer(), start);
+			break;
+		}
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+		if (CONSOLE_RC_STAT_ACC_FRAME == rc) {				// A frame is run at once & its reply is all the output, no echo or prompt.
+			consoleProcessFrame(consoleAcceptBuffer());
+			break;
+		}
+#endif
+#ifdef CONSOLE_SERVICE_TIME_BUDGET_US
+		if (time_budget_spent(start))
+			break;
+#endif
+	}
+	(void)start;
+}
+
+/* Each port in turn gets its byte budget, starting with the one after the last serviced by the previous call. The time budget if set is 
+	shared by all the ports, any not reached are serviced first on the next call. */
+void _FConsole::service() {
+	if (0 == f_nports)
+		return;
+	unsigned long start = 0;
+#ifdef CONSOLE_SERVICE_TIME_BUDGET_US
+	start = micros();
+#endif
+	const uint8_t first = (f_next < f_nports) ? f_next : 0;
+	uint8_t i = first;
+	for (uint8_t n = 0; n < f_nports; n += 1) {
+		service_port(&f_ports[i], start);
+		if (++i >= f_nports)
+			i = 0;
+#ifdef CONSOLE_SERVICE_TIME_BUDGET_US
+		if (time_budget_spent(start))
+			break;
+#endif
 	}
+	if ((i == first) && (++i >= f_nports))					// All were serviced, so the next one goes first next time.
+		i = 0;
+	f_next = i;
+	select_port(&f_ports[0]);								// Output from the application goes to the first stream.
 }
@@ -1,24 +1,63 @@
 #ifndef _FCONSOLE_H__
 #define _FCONSOLE_H__
 
+#include <Arduino.h>
+
 #include "console.h"
 
+// Policies for a full TX queue, see CONSOLE_TX_QUEUE_SIZE in the config.
+#define CONSOLE_TX_QUEUE_BLOCK 0
+#define CONSOLE_TX_QUEUE_DROP 1
+#define CONSOLE_TX_QUEUE_TRUNCATE 2
+
+// Number of streams that FConsole can serve, each has its own console so more than one needs CONSOLE_MULTI_CONTEXT.
+#ifndef CONSOLE_FCONSOLE_STREAMS
+#define CONSOLE_FCONSOLE_STREAMS 1
+#endif
+#if (CONSOLE_FCONSOLE_STREAMS > 1) && !defined(CONSOLE_MULTI_CONTEXT)
+#error More than one FConsole stream needs CONSOLE_MULTI_CONTEXT
+#endif
+
+/* User commands are called from the console via this function, so the config must have:
+	bool fconsole_cmds_user(char* cmd);
+	#define CONSOLE_USER_RECOGNISERS fconsole_cmds_user, */
+extern "C" bool fconsole_cmds_user(char* cmd);
+
 class _FConsole {
 public:
 	_FConsole() {};
+
+	// Start with a single stream, any streams added before are removed.
 	void begin(console_recogniser_func r_user, Stream& s);
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+	/* Input is read with HardwareSerial::readAvailable(). With CONSOLE_ACCEPT_DOUBLE_BUFFER and SERIAL_RX_HOOK it is instead taken directly
+		from the RX interrupt into the console's line buffers, if the core was also built with SERIAL_RX_HOOK. */
+	void begin(console_recogniser_func r_user, HardwareSerial& s);
+#endif
+
+	/* Add another stream, with its own console & output, returns false if CONSOLE_FCONSOLE_STREAMS are in use. The new stream is made current
+		so that a signon message & prompt may be printed on it. */
+	bool addStream(Stream& s);
+#ifdef HAVE_HWSERIAL_READ_AVAILABLE
+	bool addStream(HardwareSerial& s);
+#endif
+
+	// Print a prompt on the current stream.
 	void prompt();
+
+	/* Service each stream in turn, starting after the last one serviced on the previous call, so that a busy stream cannot starve the others.
+		Output from a command goes to the stream it came from. After this the first stream is current again. */
 	void service();
-	
+
 	// Shim function to call function pointer in RAM from a static function whose address can be in PROGMEM.
 	static bool r_cmds_user(char* cmd) { return (s_r_user) ? s_r_user(cmd) : false; }
-	
+
 public:		// All data public and static.
 	static console_recogniser_func s_r_user;
-	static Stream* s_stream;
+	static Stream* s_stream;						// Current stream, that consolePrint() writes to.
 };
 
 // An example of the Highlander pattern. There can be only one. If there isn't, they have a scrap and one gets it's head cut off.
 extern _FConsole FConsole;
 
-#endif
\ No newline at end of file
+#endif
@@ -4,10 +4,58 @@
 #undef CONSOLE_DATA_STACK_SIZE
 #define CONSOLE_DATA_STACK_SIZE (4)
 
-// Override printf used for output.
-#undef CONSOLE_PRINTF
-void console_printf(const char*fmt, ...);
-#define CONSOLE_PRINTF console_printf
+// Buffer output, small so that we can check what happens when it is full. Output is written to a string.
+#include <stddef.h>
+#if defined(TEST_SHARED_OUTPUT)
+#define CONSOLE_OUTPUT_SHARE_INPUT_BUFFER
+#elif !defined(TEST_UNBUFFERED)
+#define CONSOLE_OUTPUT_BUFFER_SIZE 32
+#endif
+void console_output_write(const char* buf, size_t n);
+#define CONSOLE_OUTPUT_WRITE console_output_write
+
+// Strings are decoded into a scratch arena, and may be kept in a small heap.
+#ifndef TEST_NO_SCRATCH
+#define CONSOLE_SCRATCH_SIZE 32
+#define CONSOLE_STRING_HEAP_SIZE 16
+#endif
 
 // We want example commands for trying out functionality.
 #define CONSOLE_WANT_EXAMPLE_COMMANDS
+
+// Double buffered accept, fed as if from an interrupt.
+#define CONSOLE_ACCEPT_DOUBLE_BUFFER
+
+// Small lock-free queue so that it wraps often.
+#define CONSOLE_QUEUE_SIZE 8
+
+// Lines may be run a few commands at a time.
+#define CONSOLE_PROCESS_STEP
+
+// Lines may be aborted.
+#define CONSOLE_INPUT_ABORT_CHAR '\x03'
+
+// Automated hosts may send binary frames.
+#define CONSOLE_BINARY_FRAME_CHAR '\x02'
+#define CONSOLE_FRAME_CRC
+#define CONSOLE_FRAME_REPLAY 2
+
+// Bulk upload, in chunks larger than the input buffer from the ISR.
+#define CONSOLE_BULK_ACK_CHAR '\x06'
+#define CONSOLE_BULK_CHUNK_SIZE 100
+
+// Memory dump.
+#define CONSOLE_WANT_DUMP
+
+// Two small background tasks.
+#define CONSOLE_TASKS 2
+#define CONSOLE_TASK_LINE_SIZE 16
+#define CONSOLE_TASK_STACK_SIZE 2
+
+// Many consoles, the input buffer size keeps console_t a multiple of 8 bytes for -Wpadded.
+#ifdef TEST_MULTI_CONTEXT
+#define CONSOLE_MULTI_CONTEXT
+#undef CONSOLE_INPUT_BUFFER_SIZE
+#define CONSOLE_INPUT_BUFFER_SIZE 46
+#define CONSOLE_MULTITASK 2
+#endif
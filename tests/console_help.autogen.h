@@ -8,6 +8,7 @@ static const char cmd_help_B508[] CONSOLE_PROGMEM = "DEPTH ( - u) Push stack dep
 static const char cmd_help_9F9C[] CONSOLE_PROGMEM = "CLEAR ( ... - <empty>) Remove all items from stack.";
 static const char cmd_help_5C2C[] CONSOLE_PROGMEM = "DROP (x - ) Remove top item from stack.";
 static const char cmd_help_90B7[] CONSOLE_PROGMEM = "HASH (s - u) Pop string and push hash value.";
+static const char cmd_help_DDF7[] CONSOLE_PROGMEM = "PAUSE ( - ) Give way to other work, returns from consoleProcessStep().";
 static const char cmd_help_B58E[] CONSOLE_PROGMEM = "+ (x1 x2 - x3) Add: x3 = x1 + x2.";
 static const char cmd_help_B588[] CONSOLE_PROGMEM = "- (x1 x2 - x3) Subtract: x3 = x1 - x2.";
 static const char cmd_help_B58F[] CONSOLE_PROGMEM = "* (d1 d2 - d3) Signed multiply: d3 = d1 * d2.";
@@ -15,6 +16,7 @@ static const char cmd_help_6B97[] CONSOLE_PROGMEM = "RSHIFT (u1 n - u2) Logical
 static const char cmd_help_B58A[] CONSOLE_PROGMEM = "/ (d1 d2 - d3) Signed dvide: d3 = d1 / d2.";
 static const char cmd_help_73DF[] CONSOLE_PROGMEM = "U/ (u1 u2 - u3) Unsigned divide: u3 = u1 / u2.";
 static const char cmd_help_7A79[] CONSOLE_PROGMEM = "NEGATE (d1 - d2) Negate signed value: d2 = -d1.";
+static const char cmd_help_7F74[] CONSOLE_PROGMEM = "COUNTDOWN (u - ) Print u down to 1, yielding after each.";
 static const char cmd_help_B586[] CONSOLE_PROGMEM = "# ( - ) Comment, rest of input ignored.";
 static const char cmd_help_4069[] CONSOLE_PROGMEM = "RAISE (i - ) Raise value as exception.";
 static const char cmd_help_C745[] CONSOLE_PROGMEM = "EXIT ( - ?) Exit console.";
@@ -24,6 +26,18 @@ static const char cmd_help_47B4[] CONSOLE_PROGMEM = "PRINT (x i - ) Call console
 static const char cmd_help_B0B4[] CONSOLE_PROGMEM = "??HELP ( - ) Print (wordy) help for all commands.";
 static const char cmd_help_74CB[] CONSOLE_PROGMEM = "?HELP ( - ) Print list of all commands.";
 static const char cmd_help_7D54[] CONSOLE_PROGMEM = "HELP (s - ) Search for help on given command.";
+static const char cmd_help_129E[] CONSOLE_PROGMEM = "KEEP (s1 - s2) Copy string to heap.";
+static const char cmd_help_1B7D[] CONSOLE_PROGMEM = "CKEEP (a1 - a2) Copy counted string, as from a hex string, to heap.";
+static const char cmd_help_942A[] CONSOLE_PROGMEM = "KEEP-CLEAR ( - ) Free all kept strings.";
+static const char cmd_help_86B8[] CONSOLE_PROGMEM = "EVERY (u - i) Run the rest of the line every u ms, push task id.";
+static const char cmd_help_1341[] CONSOLE_PROGMEM = "AFTER (u - i) Run the rest of the line once after u ms, push task id.";
+static const char cmd_help_837B[] CONSOLE_PROGMEM = "TASKS ( - ) List tasks as id, period & line.";
+static const char cmd_help_01A7[] CONSOLE_PROGMEM = "KILL (i - ) Remove task.";
+static const char cmd_help_4FE9[] CONSOLE_PROGMEM = "DUMP (a u - ) Print u bytes of RAM from a as lines of address & 16 hex bytes.";
+static const char cmd_help_F1F4[] CONSOLE_PROGMEM = "DUMP-P (a u - ) Print u bytes of PROGMEM from a as lines of address & 16 hex bytes.";
+static const char cmd_help_F1E6[] CONSOLE_PROGMEM = "DUMP-B (a u - ) Write u bytes of RAM from a raw.";
+static const char cmd_help_3036[] CONSOLE_PROGMEM = "DUMP-PB (a u - ) Write u bytes of PROGMEM from a raw.";
+static const char cmd_help_C246[] CONSOLE_PROGMEM = "UPLOAD (u - ) Take the next u bytes of input after this line raw & pass them to the bulk sink.";
 
 static const char* const help_cmds[] CONSOLE_PROGMEM = {
     cmd_help_B58B,
@@ -34,6 +48,7 @@ static const char* const help_cmds[] CONSOLE_PROGMEM = {
     cmd_help_9F9C,
     cmd_help_5C2C,
     cmd_help_90B7,
+    cmd_help_DDF7,
     cmd_help_B58E,
     cmd_help_B588,
     cmd_help_B58F,
@@ -41,6 +56,7 @@ static const char* const help_cmds[] CONSOLE_PROGMEM = {
     cmd_help_B58A,
     cmd_help_73DF,
     cmd_help_7A79,
+    cmd_help_7F74,
     cmd_help_B586,
     cmd_help_4069,
     cmd_help_C745,
@@ -50,6 +66,18 @@ static const char* const help_cmds[] CONSOLE_PROGMEM = {
     cmd_help_B0B4,
     cmd_help_74CB,
     cmd_help_7D54,
+    cmd_help_129E,
+    cmd_help_1B7D,
+    cmd_help_942A,
+    cmd_help_86B8,
+    cmd_help_1341,
+    cmd_help_837B,
+    cmd_help_01A7,
+    cmd_help_4FE9,
+    cmd_help_F1F4,
+    cmd_help_F1E6,
+    cmd_help_3036,
+    cmd_help_C246,
 };
 
 static const uint16_t help_hashes[] CONSOLE_PROGMEM = {
@@ -61,6 +89,7 @@ static const uint16_t help_hashes[] CONSOLE_PROGMEM = {
     0x9F9C,
     0x5C2C,
     0x90B7,
+    0xDDF7,
     0xB58E,
     0xB588,
     0xB58F,
@@ -68,6 +97,7 @@ static const uint16_t help_hashes[] CONSOLE_PROGMEM = {
     0xB58A,
     0x73DF,
     0x7A79,
+    0x7F74,
     0xB586,
     0x4069,
     0xC745,
@@ -77,5 +107,17 @@ static const uint16_t help_hashes[] CONSOLE_PROGMEM = {
     0xB0B4,
     0x74CB,
     0x7D54,
+    0x129E,
+    0x1B7D,
+    0x942A,
+    0x86B8,
+    0x1341,
+    0x837B,
+    0x01A7,
+    0x4FE9,
+    0xF1F4,
+    0xF1E6,
+    0x3036,
+    0xC246,
 };
 
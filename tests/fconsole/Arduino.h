@@ -0,0 +1,49 @@
+// Just enough of the Arduino core to build FConsole on a desktop for testing.
+#ifndef ARDUINO_H__
+#define ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s_) (s_)
+#define pgm_read_byte(p_) (*(const uint8_t*)(p_))
+#define memcpy_P memcpy
+
+class __FlashStringHelper;
+#define F(s_) ((const __FlashStringHelper*)(s_))
+
+class Print {
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* b, size_t n) { size_t r = 0; while (n--) r += write(*b++); return r; }
+	virtual int availableForWrite() { return 0; }
+	virtual void flush() {}
+	size_t print(const __FlashStringHelper* s) { return write((const uint8_t*)s, strlen((const char*)s)); }
+	size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+	size_t print(char c) { return write((uint8_t)c); }
+};
+
+class Stream : public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	size_t readBytes(uint8_t* b, size_t n) {
+		size_t i;
+		for (i = 0; i < n; i += 1) {
+			const int c = read();
+			if (c < 0)
+				break;
+			b[i] = (uint8_t)c;
+		}
+		return i;
+	}
+};
+
+unsigned long micros(void);
+unsigned long millis(void);
+
+#endif // ARDUINO_H__
@@ -0,0 +1,2 @@
+// Stream is declared in our Arduino.h.
+#include "Arduino.h"
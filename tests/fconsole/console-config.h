@@ -0,0 +1,37 @@
+#include "console-config.sample.h"
+
+// FConsole supplies consolePrint() & writes to its streams.
+#undef CONSOLE_DEFINE_PRINT
+
+// Input lines end with a newline.
+#undef CONSOLE_INPUT_NEWLINE_CHAR
+#define CONSOLE_INPUT_NEWLINE_CHAR '\n'
+
+// Three streams, each with its own console.
+#define CONSOLE_MULTI_CONTEXT
+#define CONSOLE_FCONSOLE_STREAMS 3
+
+// Lines are run a few commands per call to service().
+#define CONSOLE_PROCESS_STEP
+#define CONSOLE_SERVICE_TOKEN_BUDGET 4
+
+// Output buffered per stream.
+#define CONSOLE_OUTPUT_BUFFER_SIZE 32
+
+// A running line may be aborted.
+#define CONSOLE_INPUT_ABORT_CHAR '\x03'
+
+// Streams may be switched to machine mode.
+#define CONSOLE_MACHINE_MODE
+
+// Automated hosts may send binary frames.
+#define CONSOLE_BINARY_FRAME_CHAR '\x02'
+// A background task per stream.
+#define CONSOLE_TASKS 1
+#define CONSOLE_TASK_LINE_SIZE 16
+#define CONSOLE_TASK_STACK_SIZE 1
+
+// User commands are called by FConsole.
+bool fconsole_cmds_user(char* cmd);
+#undef CONSOLE_USER_RECOGNISERS
+#define CONSOLE_USER_RECOGNISERS fconsole_cmds_user,
@@ -0,0 +1,286 @@
+// Tests for FConsole serving several streams, built on a desktop with a minimal Arduino shim.
+#include <stdio.h>
+#include <string.h>
+
+#include "Arduino.h"
+#include "fconsole.h"
+
+extern "C" {
+#include "minunit.h"
+}
+
+static unsigned long f_millis;
+unsigned long micros(void) { return 0; }
+unsigned long millis(void) { return f_millis; }
+
+// Fake stream that reads from a string, or a buffer that may hold nuls, & writes to a static buffer.
+class StaticBufferStream : public Stream {
+public:
+	StaticBufferStream() : _in(""), _end(_in), _pos(0) { _buf[0] = '\0'; }
+	virtual int available() { return (int)(_end - _in); }
+	virtual int read() { return (_in < _end) ? (uint8_t)*_in++ : -1; }
+	virtual int peek() { return (_in < _end) ? (uint8_t)*_in : -1; }
+	virtual int availableForWrite() { return (int)(sizeof(_buf) - 1 - _pos); }
+	virtual size_t write(uint8_t c) { if (_pos < sizeof(_buf) - 1) _buf[_pos++] = (char)c; _buf[_pos] = '\0'; return 1; }
+	void input(const char* s) { input(s, strlen(s)); }
+	void input(const char* s, size_t n) { _in = s; _end = s + n; }
+	const char* get() const { return _buf; }
+	size_t size() const { return _pos; }
+	void clear() { _pos = 0; _buf[0] = '\0'; }
+private:
+	const char* _in;
+	const char* _end;
+	size_t _pos;
+	char _buf[200];
+};
+
+static StaticBufferStream f_s[CONSOLE_FCONSOLE_STREAMS + 1];
+
+static bool cmds_user(char* cmd) {
+	switch (console_hash(cmd)) {
+		case /** DUP (x - x x) Duplicate top item. **/ 0xbc84: console_u_push(console_u_tos()); break;
+		default: return false;
+	}
+	return true;
+}
+
+const char* mu_test_setup(void) {
+	FConsole.begin(cmds_user, f_s[0]);
+	for (uint8_t i = 1; i < CONSOLE_FCONSOLE_STREAMS; i += 1)
+		FConsole.addStream(f_s[i]);
+	f_millis = 0;
+	for (uint8_t i = 0; i < CONSOLE_FCONSOLE_STREAMS + 1; i += 1) {
+		f_s[i].input("");
+		f_s[i].clear();
+	}
+	return NULL;
+}
+void mu_test_teardown(void) {
+}
+
+// Each stream has its own console, output from a line goes back to the stream it came from.
+static const char* check_routing(void) {
+	f_s[0].input("1 2 DROP .\n");
+	f_s[1].input("10 DUP U.\n");
+	f_s[2].input("$ff .\n");
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 DROP . -> 1 \n> ");
+	mu_assert_equal_str(f_s[1].get(), "10 DUP U. -> +10 \n> ");
+	mu_assert_equal_str(f_s[2].get(), "$ff . -> 255 \n> ");
+	return NULL;
+}
+
+// Each stream has its own stack.
+static const char* check_separate_stacks(void) {
+	f_s[0].input("11\n.\n");
+	f_s[1].input("22\n.\n");
+	FConsole.service();
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "11 -> \n> . -> 11 \n> ");
+	mu_assert_equal_str(f_s[1].get(), "22 -> \n> . -> 22 \n> ");
+	return NULL;
+}
+
+// A stream with lots of input runs only one line per call, so it cannot starve the others.
+static const char* check_fair(void) {
+	f_s[0].input("1 .\n2 .\n3 .\n4 .\n");
+	f_s[2].input("5 .\n");
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 . -> 1 \n> ");
+	mu_assert_equal_str(f_s[2].get(), "5 . -> 5 \n> ");
+	FConsole.service();
+	FConsole.service();
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 . -> 1 \n> 2 . -> 2 \n> 3 . -> 3 \n> 4 . -> 4 \n> ");
+	mu_assert_equal_str(f_s[2].get(), "5 . -> 5 \n> ");
+	return NULL;
+}
+
+// A long line is run a few commands per call, meanwhile other streams are serviced & no more input is taken from its own.
+static const char* check_step(void) {
+	f_s[0].input("1 2 3 4 . . . .\n9 .\n");
+	f_s[1].input("7 .\n");
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 3 4 . . . . -> ");
+	mu_assert_equal_str(f_s[1].get(), "7 . -> 7 \n> ");
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 3 4 . . . . -> 4 3 2 1 \n> ");
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 3 4 . . . . -> 4 3 2 1 \n> 9 . -> 9 \n> ");
+	return NULL;
+}
+
+// The abort char stops a running line at the next command, input after it is taken as usual.
+static const char* check_abort(void) {
+	f_s[0].input("1 2 3 4 . . . .\n\x03" "9 .\n");
+	FConsole.service();
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 3 4 . . . . -> Error: `.': aborted : 11 \n> ");
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 3 4 . . . . -> Error: `.': aborted : 11 \n> 9 . -> 9 \n> ");
+	return NULL;
+}
+
+// An abort char typed after the next line still stops the running one, & the next line is run after it.
+static const char* check_abort_queued(void) {
+	f_s[0].input("1 2 3 4 . . . .\n9 .\n\x03");
+	FConsole.service();
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 3 4 . . . . -> Error: `.': aborted : 11 \n> ");
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "1 2 3 4 . . . . -> Error: `.': aborted : 11 \n> 9 . -> 9 \n> ");
+	return NULL;
+}
+
+/* In machine mode replies are just the sequence number, output & status, with no echo or prompt. A line that switches mode always ends with
+	the status in machine format, after the echo going in & followed by the prompt going out. */
+static const char* check_machine(void) {
+	f_s[1].input("1 MACHINE\n17 1 2 DROP .\n18 FOO\n 19\n$1 .\n20 0 MACHINE\n1 MACHINE FOO\n21 0 MACHINE\n0 MACHINE\n");
+	for (uint8_t i = 0; i < 9; i += 1)
+		FConsole.service();
+	mu_assert_equal_str(f_s[1].get(), "1 MACHINE -> =0\n17 1 =0\n18 =7 FOO\n19 =0\n1 =0\n20 =0\n> 1 MACHINE FOO -> =7 FOO\n21 =0\n> 0 MACHINE -> \n> ");
+	mu_assert_equal_str(f_s[0].get(), "");
+	return NULL;
+}
+
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+static char* frame_put_cell(char* p, console_uint_t x) {
+	for (size_t i = 0; i < sizeof(x); i += 1, x = (console_uint_t)(x >> 8))
+		*p++ = (char)x;
+	return p;
+}
+
+// A binary frame is answered with just the reply frame, then text lines work as before.
+static const char* check_frame(void) {
+	char in[40], reply[40];
+	char* p = in;
+	*p++ = CONSOLE_BINARY_FRAME_CHAR;
+	*p++ = (char)(1 + CONSOLE_CELL_SIZE + 2);
+	*p++ = 1;
+	p = frame_put_cell(p, 21);
+	*p++ = (char)0x84; *p++ = (char)0xbc;			// DUP
+	memcpy(p, "3 .\n", 4);
+	f_s[2].input(in, (size_t)(p + 4 - in));
+
+	FConsole.service();
+	p = reply;
+	*p++ = CONSOLE_BINARY_FRAME_CHAR;
+	*p++ = (char)(1 + 2 * CONSOLE_CELL_SIZE);
+	*p++ = CONSOLE_RC_OK;
+	p = frame_put_cell(p, 21);
+	p = frame_put_cell(p, 21);
+	mu_assert_equal_int(f_s[2].size(), (size_t)(p - reply));
+	mu_assert_equal_int(memcmp(f_s[2].get(), reply, (size_t)(p - reply)), 0);
+	FConsole.service();
+	mu_assert_equal_str(&f_s[2].get()[p - reply], "3 . -> 3 \n> ");
+	return NULL;
+}
+#endif
+
+// Output from the application after service() goes to the first stream.
+static const char* check_print_first(void) {
+	f_s[1].input("1 .\n");
+	FConsole.service();
+	f_s[1].clear();
+	consolePrint(CONSOLE_PRINT_SIGNED, 42);
+	consoleOutputFlush();
+	mu_assert_equal_str(f_s[0].get(), "42 ");
+	mu_assert_equal_str(f_s[1].get(), "");
+	return NULL;
+}
+
+// A background task runs between lines on the stream that set it up, with a prompt after its output.
+static const char* check_tasks(void) {
+	f_s[1].input("100 EVERY 7 .\n");
+	FConsole.service();
+	mu_assert_equal_str(f_s[1].get(), "100 EVERY 7 . -> \n> ");
+	f_s[1].clear();
+	f_millis = 99;
+	FConsole.service();
+	mu_assert_equal_str(f_s[1].get(), "");
+	f_millis = 100;
+	FConsole.service();
+	mu_assert_equal_str(f_s[0].get(), "");
+	mu_assert_equal_str(f_s[1].get(), "[1] 7 \n> ");
+	return NULL;
+}
+
+#ifdef CONSOLE_TX_QUEUE_SIZE
+// A stream that does not implement availableForWrite(), so it always has no room.
+class NoRoomStream : public StaticBufferStream {
+public:
+	virtual int availableForWrite() { return Print::availableForWrite(); }
+};
+static NoRoomStream f_no_room;
+
+// A stream found to have no room when it is added does not implement availableForWrite(), so output is written at once.
+static const char* check_tx_no_avail(void) {
+	FConsole.begin(cmds_user, f_no_room);
+	f_no_room.clear();
+	f_no_room.input("1 .\n");
+	FConsole.service();
+	mu_assert_equal_str(f_no_room.get(), "1 . -> 1 \n> ");
+	return NULL;
+}
+
+// A stream that is full for a while, & counts any write while it has no room.
+class FullStream : public StaticBufferStream {
+public:
+	FullStream() : full(false), full_writes(0) {}
+	virtual int availableForWrite() { return full ? 0 : StaticBufferStream::availableForWrite(); }
+	virtual size_t write(uint8_t c) { if (full) full_writes += 1; return StaticBufferStream::write(c); }
+	bool full;
+	unsigned full_writes;
+};
+static FullStream f_full;
+
+// Output for a stream that is full waits in the queue, however many lines are printed or service() is called, & is written once it has room.
+static const char* check_tx_full(void) {
+	FConsole.begin(cmds_user, f_full);
+	f_full.clear();
+	f_full.full = true;
+	f_full.input("1 .\n2 .\n3 .\n");											// Each newline also drains the queue.
+	for (uint8_t i = 0; i < 16; i += 1)
+		FConsole.service();
+	mu_assert_equal_str(f_full.get(), "");
+	mu_assert_equal_int(f_full.full_writes, 0);
+	f_full.full = false;
+	FConsole.service();
+	mu_assert_equal_str(f_full.get(), "1 . -> 1 \n> 2 . -> 2 \n> 3 . -> 3 \n> ");
+	return NULL;
+}
+#endif
+
+// No more than CONSOLE_FCONSOLE_STREAMS.
+static const char* check_add_full(void) {
+	mu_assert_equal_int(FConsole.addStream(f_s[CONSOLE_FCONSOLE_STREAMS]), false);
+	FConsole.begin(cmds_user, f_s[0]);
+	mu_assert_equal_int(FConsole.addStream(f_s[CONSOLE_FCONSOLE_STREAMS]), true);
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	(void)argc; (void)argv;
+	printf("FConsole Unit Tests: %u streams.\n", (unsigned)CONSOLE_FCONSOLE_STREAMS);
+
+	mu_init();
+	mu_run_test(check_routing());
+	mu_run_test(check_separate_stacks());
+	mu_run_test(check_fair());
+	mu_run_test(check_step());
+	mu_run_test(check_abort());
+	mu_run_test(check_abort_queued());
+	mu_run_test(check_machine());
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	mu_run_test(check_frame());
+#endif
+	mu_run_test(check_print_first());
+	mu_run_test(check_tasks());
+#ifdef CONSOLE_TX_QUEUE_SIZE
+	mu_run_test(check_tx_no_avail());
+	mu_run_test(check_tx_full());
+#endif
+	mu_run_test(check_add_full());
+	mu_print_summary();
+	return mu_rc();
+}
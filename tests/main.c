@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdlib.h>
 #include <stdarg.h>
 
 #include "console.h"
@@ -10,17 +11,24 @@
 
 #pragma GCC diagnostic ignored "-Wunused-function"
 
-// Test print routine, writes to string.
+// Type of a cell passed through `...', which is promoted to int if it is smaller.
+#if CONSOLE_CELL_SIZE < 4
+typedef int console_vararg_t;
+#else
+typedef console_int_t console_vararg_t;
+#endif
+
+// Test output routine, writes to string.
 static char print_output_buf[100], *print_output_p;
-static void print_output_init(void) { print_output_p = print_output_buf; *print_output_p = '\0'; }
+static void print_output_init(void) { consoleOutputFlush(); print_output_p = print_output_buf; *print_output_p = '\0'; }
 static const char* print_output_get(void) {
+	consoleOutputFlush();
 	return print_output_buf;
 }
-void console_printf(const char*fmt, ...) {
-	va_list ap;
-	va_start(ap, fmt);
-	int ns = vsprintf(print_output_p, fmt, ap);
-	print_output_p += ns;
+void console_output_write(const char* buf, size_t n) {
+	memcpy(print_output_p, buf, n);
+	print_output_p += n;
+	*print_output_p = '\0';
 }
 
 const char* mu_test_setup(void) {
@@ -33,12 +41,54 @@ void mu_test_teardown(void) {
 }
 
 // Test console output function.
-static char* check_print(console_small_uint_t opt, console_int_t x, const char* output) {
+static char* check_print(console_small_uint_t opt, console_arg_t x, const char* output) {
 	consolePrint(opt, x);
 	mu_assert_equal_str(print_output_get(), output);	// Verify output string...
 	return NULL;
 }
 
+// Check built-in number formatting against printf.
+static char* check_print_vs_printf(void) {
+	char expected[40];
+	console_uint_t u = 1U;
+	for (int i = 0; i < 200; i += 1) {
+		u = (console_uint_t)(u * 2862933555777941757ULL + 3037000493ULL);		// Cheap random numbers.
+		const console_uint_t x = u >> (i % (8 * CONSOLE_CELL_SIZE));				// With lots of small ones.
+
+		print_output_init();
+		sprintf(expected, "%" CONSOLE_PRINTF_FMT_MOD "d ", (console_int_t)x);
+		consolePrint(CONSOLE_PRINT_SIGNED, (console_int_t)x);
+		mu_assert_equal_str(print_output_get(), expected);
+
+		print_output_init();
+		sprintf(expected, "+%" CONSOLE_PRINTF_FMT_MOD "u ", x);
+		consolePrint(CONSOLE_PRINT_UNSIGNED, (console_int_t)x);
+		mu_assert_equal_str(print_output_get(), expected);
+
+		print_output_init();
+		sprintf(expected, "$%0*" CONSOLE_PRINTF_FMT_MOD "X ", CONSOLE_CELL_SIZE * 2, x);
+		consolePrint(CONSOLE_PRINT_HEX, (console_int_t)x);
+		mu_assert_equal_str(print_output_get(), expected);
+	}
+	return NULL;
+}
+
+#ifdef CONSOLE_OUTPUT_BUFFER_SIZE
+// Check that output is only written on a newline or when the buffer is full.
+static char* check_print_buffered(void) {
+	consolePrint(CONSOLE_PRINT_SIGNED, 1);
+	mu_assert_equal_str(print_output_buf, "");
+	consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+	mu_assert_equal_str(print_output_buf, "1 \n");
+	consolePrint(CONSOLE_PRINT_STR, console_ptr_arg("abcdefghijklmnopqrstuvwxyz0123456789"));
+	mu_assert_equal_str(print_output_buf, "1 \nabcdefghijklmnopqrstuvwxyz012345");
+	consolePrint(CONSOLE_PRINT_HEX2, 0x12);
+	consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+	mu_assert_equal_str(print_output_buf, "1 \nabcdefghijklmnopqrstuvwxyz0123456789 $12 \n");
+	return NULL;
+}
+#endif
+
 static char* check_console(const char* input, const char* output, console_rc_t rc_expected, console_small_uint_t depth_expected, ...) {
 	char inbuf[100];									// Copy input string as we are not meant to write to string literals.
 	va_list ap;
@@ -62,7 +112,7 @@ static char* check_console(const char* input, const char* output, console_rc_t r
 	va_start(ap, depth_expected);
 	i = console_u_depth();
 	while (i-- > 0) {
-		if (console_u_get(i) != va_arg(ap, console_int_t))
+		if (console_u_get(i) != (console_int_t)va_arg(ap, console_vararg_t))
 			return mu_msg;
 	}
 
@@ -82,27 +132,56 @@ static char* check_hex_string(const char* input, console_small_uint_t len_expect
 	mu_assert_equal_int(console_u_depth(), 1);
 
 	// Build error message for memory.
-	mem_ptr = (uint8_t*)console_u_tos();
+	mem_ptr = (uint8_t*)console_cell_to_ptr(console_u_tos());
 	mu_add_msg("Hex string: ");
 	i = *mem_ptr++;
 	while (i-- > 0)
 		mu_add_msg("%02X", *mem_ptr++);
 
 	// Verify memory...
-	mem_ptr = (uint8_t*)console_u_tos();
+	mem_ptr = (uint8_t*)console_cell_to_ptr(console_u_tos());
 	if (*mem_ptr++ != len_expected)
 		return mu_msg;
 
 	va_start(ap, len_expected);
 	i = len_expected;
 	while (i-- > 0) {
-		if (*mem_ptr++ != va_arg(ap, console_int_t))
+		if (*mem_ptr++ != va_arg(ap, int))
 			return mu_msg;
 	}
 
 	return NULL;
 }
 
+#ifdef CONSOLE_STRING_HEAP_SIZE
+// Strings kept in the heap outlive the line they were entered on, and may be printed on a later line.
+static char* check_keep(const char* keep, const char* later, console_rc_t rc_expected, const char* output) {
+	char inbuf[100];
+
+	strcpy(inbuf, keep);
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	strcpy(inbuf, later);
+	memset(inbuf + strlen(inbuf) + 1, '?', sizeof(inbuf) - strlen(inbuf) - 1);	// Trash the rest of the buffer.
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), rc_expected);
+	mu_assert_equal_str(print_output_get(), output);
+	return NULL;
+}
+
+static char* check_ckeep(void) {
+	char inbuf[100];
+
+	strcpy(inbuf, "&1a2b CKEEP");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	strcpy(inbuf, "&ffff DROP");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	const uint8_t* mem_ptr = (const uint8_t*)console_cell_to_ptr(console_u_tos());
+	mu_assert_equal_int(mem_ptr[0], 2);
+	mu_assert_equal_int(mem_ptr[1], 0x1a);
+	mu_assert_equal_int(mem_ptr[2], 0x2b);
+	return NULL;
+}
+#endif // CONSOLE_STRING_HEAP_SIZE
+
 static char* check_accept_ovf(uint8_t char_count, uint8_t len_expected, uint8_t rc_expected) {
 	console_rc_t rc;
 
@@ -143,9 +222,546 @@ static char* check_accept_line_cancel(bool overflow) {
 	return NULL;
 }
 
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+static void accept_isr_str(const char* s) {
+	while ('\0' != *s)
+		consoleAcceptIsr(*s++);
+}
+static char* check_accept_double_buffer(void) {
+	char* line;
+	accept_isr_str("ab\r");
+	mu_assert_equal_int(CONSOLE_RC_OK, consoleAcceptLine(&line));
+	mu_assert_equal_str(line, "ab");
+	accept_isr_str("cd");												// Next line received while the last is taken.
+	mu_assert_equal_str(line, "ab");
+	mu_assert_equal_int(CONSOLE_RC_STAT_ACC_PEND, consoleAcceptLine(&line));	// Releases "ab".
+	accept_isr_str("\ref\r");											// "ef" dropped as "cd" not yet taken.
+	mu_assert_equal_int(CONSOLE_RC_ERR_ACC_OVF, consoleAcceptLine(&line));
+	mu_assert_equal_str(line, "");
+	mu_assert_equal_int(CONSOLE_RC_OK, consoleAcceptLine(&line));
+	mu_assert_equal_str(line, "cd");
+	mu_assert_equal_int(CONSOLE_RC_STAT_ACC_PEND, consoleAcceptLine(&line));
+	return NULL;
+}
+#endif // CONSOLE_ACCEPT_DOUBLE_BUFFER
+
+#ifdef CONSOLE_QUEUE_SIZE
+// Queue holds one less than its size, and lines may span calls to consoleServiceQueue().
+static char* check_queue(void) {
+	static console_queue_t q;
+	char buf[CONSOLE_QUEUE_SIZE];
+
+	consoleQueueInit(&q);
+	mu_assert_equal_int(consoleQueueRead(&q, buf, sizeof(buf)), 0);
+	mu_assert_equal_int(consoleQueueWrite(&q, "abcdefghij", 10), CONSOLE_QUEUE_SIZE - 1);
+	mu_assert_equal_int(consoleQueueRead(&q, buf, 3), 3);
+	mu_assert_equal_int(consoleQueueWrite(&q, "xyz", 3), 3);						// Wraps.
+	mu_assert_equal_int(consoleQueueRead(&q, buf, sizeof(buf)), CONSOLE_QUEUE_SIZE - 1);
+	buf[CONSOLE_QUEUE_SIZE - 1] = '\0';
+	mu_assert_equal_str(buf, "defgxyz");
+
+	mu_assert_equal_int(consoleQueueWrite(&q, "12 3", 4), 4);
+	mu_assert_equal_int(consoleServiceQueue(&q, NULL), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleQueueWrite(&q, "4 .\r5\r", 6), 6);
+	mu_assert_equal_int(consoleServiceQueue(&q, NULL), CONSOLE_RC_OK);				// Runs the first line only.
+	mu_assert_equal_str(print_output_get(), "34 ");
+	mu_assert_equal_int(console_u_depth(), 1);
+	mu_assert_equal_int(consoleServiceQueue(&q, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_int(console_u_depth(), 2);
+	mu_assert_equal_int(consoleServiceQueue(&q, NULL), CONSOLE_RC_STAT_ACC_PEND);
+	return NULL;
+}
+#endif // CONSOLE_QUEUE_SIZE
+
+#ifdef CONSOLE_PROCESS_STEP
+// Line run a few commands at a time, keeping the stack between steps, with the failing command reported.
+static char* check_process_step(void) {
+	char inbuf[30];
+	const char* cmd = NULL;
+
+	strcpy(inbuf, "1 2 + 3 .");
+	consoleProcessBegin(inbuf);
+	mu_assert_equal_int(consoleProcessStep(2, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	mu_assert_equal_int(console_u_depth(), 2);
+	mu_assert_equal_int(consoleProcessStep(1, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	mu_assert_equal_int(console_u_depth(), 1);
+	mu_assert_equal_int(consoleProcessStep(2, &cmd), CONSOLE_RC_OK);	// Exactly the rest.
+	mu_assert_equal_str(print_output_get(), "3 ");
+	mu_assert_equal_int(consoleProcessStep(2, &cmd), CONSOLE_RC_OK);	// Nothing more to do.
+	mu_assert_equal_int(console_u_depth(), 1);
+
+	strcpy(inbuf, "1 foo 2");
+	consoleProcessBegin(inbuf);
+	mu_assert_equal_int(consoleProcessStep(1, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	mu_assert_equal_int(consoleProcessStep(0, &cmd), CONSOLE_RC_ERR_BAD_CMD);
+	mu_assert_equal_str(cmd, "foo");
+	mu_assert_equal_int(consoleProcessStep(0, &cmd), CONSOLE_RC_OK);
+	mu_assert_equal_int(console_u_depth(), 2);
+	return NULL;
+}
+
+// A command that yields is called again on the next step with the state it gave.
+static char* check_yield(void) {
+	char inbuf[30];
+	const char* cmd = NULL;
+
+	strcpy(inbuf, "3 COUNTDOWN 7");
+	consoleProcessBegin(inbuf);
+	mu_assert_equal_int(consoleProcessStep(2, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	mu_assert_equal_str(print_output_get(), "3 ");
+	mu_assert_equal_str(cmd, "COUNTDOWN");
+	mu_assert_equal_int(console_yield_state(), 2);
+	mu_assert_equal_int(consoleProcessStep(1, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	mu_assert_equal_str(print_output_get(), "3 2 ");
+	mu_assert_equal_int(consoleProcessStep(1, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	mu_assert_equal_str(print_output_get(), "3 2 1 ");
+	mu_assert_equal_int(consoleProcessStep(0, &cmd), CONSOLE_RC_OK);
+	mu_assert_equal_int(console_u_depth(), 1);
+	mu_assert_equal_int(console_u_pop(), 7);
+
+	strcpy(inbuf, "2 COUNTDOWN 4 COUNTDOWN");			// Runs to the end without steps.
+	print_output_init();
+	mu_assert_equal_int(consoleProcess(inbuf, &cmd), CONSOLE_RC_OK);
+	mu_assert_equal_str(print_output_get(), "2 1 4 3 2 1 ");
+	mu_assert_equal_int(console_u_depth(), 0);
+
+	strcpy(inbuf, "2 COUNTDOWN");						// A new line abandons a yielded command.
+	consoleProcessBegin(inbuf);
+	mu_assert_equal_int(consoleProcessStep(2, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	strcpy(inbuf, "5");
+	mu_assert_equal_int(consoleProcess(inbuf, &cmd), CONSOLE_RC_OK);
+	mu_assert_equal_int(console_yield_state(), 0);
+	mu_assert_equal_int(console_u_pop(), 5);
+	return NULL;
+}
+#endif // CONSOLE_PROCESS_STEP
+
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+// An abort stops the running line before its next command, but not the next line.
+static char* check_abort(void) {
+	char inbuf[30];
+	const char* cmd = NULL;
+
+	strcpy(inbuf, "1 2 3 COUNTDOWN 4");
+	consoleProcessBegin(inbuf);
+	mu_assert_equal_int(consoleProcessStep(4, &cmd), CONSOLE_RC_STAT_PROC_PEND);
+	consoleAbort();
+	mu_assert_equal_int(consoleProcessStep(0, &cmd), CONSOLE_RC_ERR_ABORTED);
+	mu_assert_equal_str(cmd, "COUNTDOWN");
+	mu_assert_equal_str(print_output_get(), "3 ");
+	mu_assert_equal_int(console_u_depth(), 2);
+
+	consoleAbort();
+	strcpy(inbuf, "5");
+	mu_assert_equal_int(consoleProcess(inbuf, &cmd), CONSOLE_RC_OK);
+	mu_assert_equal_int(console_u_depth(), 3);
+	return NULL;
+}
+#endif // CONSOLE_INPUT_ABORT_CHAR
+
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+static uint8_t* frame_put_cell(uint8_t* p, console_uint_t x) {
+	for (size_t i = 0; i < sizeof(x); i += 1, x = (console_uint_t)(x >> 8))
+		*p++ = (uint8_t)x;
+	return p;
+}
+
+// Make a frame, or the reply to one, from a body of n bytes, returning its size. Requests & replies have the same format.
+static size_t frame_make(uint8_t* frame, const uint8_t* body, size_t n, uint8_t seq) {
+	uint8_t* p = frame;
+	*p++ = CONSOLE_BINARY_FRAME_CHAR;
+#ifdef CONSOLE_FRAME_CRC
+	*p++ = (uint8_t)(n + 3);
+	*p++ = (uint8_t)~(n + 3);
+	*p++ = seq;
+	memcpy(p, body, n);
+	p += n;
+	const uint16_t crc = console_crc16(&frame[3], n + 1);
+	*p++ = (uint8_t)crc;
+	*p++ = (uint8_t)(crc >> 8);
+#else
+	(void)seq;
+	*p++ = (uint8_t)n;
+	memcpy(p, body, n);
+	p += n;
+#endif
+	return (size_t)(p - frame);
+}
+
+// Accept a frame, checking that only the last byte completes it, & run it.
+static console_rc_t frame_send(const uint8_t* frame, size_t n) {
+	for (size_t i = 0; i < (n - 1); i += 1) {
+		if (CONSOLE_RC_STAT_ACC_PEND != consoleAccept((char)frame[i]))
+			return CONSOLE_RC_ERR_NO_CHEESE;
+	}
+	if (CONSOLE_RC_STAT_ACC_FRAME != consoleAccept((char)frame[n - 1]))
+		return CONSOLE_RC_ERR_NO_CHEESE;
+	return consoleProcessFrame(consoleAcceptBuffer());
+}
+
+// Check that the output is the text, then the reply with the status & a single cell if depth is 1, then clear it. Replies are compared as bytes.
+static char* check_frame_reply(const char* text, uint8_t seq, console_rc_t rc, console_small_uint_t depth, console_uint_t r1) {
+	uint8_t body[1 + CONSOLE_CELL_SIZE], reply[CONSOLE_FRAME_REPLY_SIZE];
+	body[0] = (uint8_t)rc;
+	if (depth > 0)
+		frame_put_cell(&body[1], r1);
+	const size_t n = frame_make(reply, body, 1U + depth * CONSOLE_CELL_SIZE, seq);
+	const size_t text_len = strlen(text);
+	print_output_get();
+	mu_assert_equal_int((size_t)(print_output_p - print_output_buf), text_len + n);
+	mu_assert_equal_int(memcmp(print_output_buf, text, text_len), 0);
+	mu_assert_equal_int(memcmp(&print_output_buf[text_len], reply, n), 0);
+	print_output_init();
+	return NULL;
+}
+
+// Make a frame body with the cells & a command hash, if not zero, returning its size.
+static size_t frame_body(uint8_t* body, console_small_uint_t ncells, console_uint_t c1, uint16_t hash) {
+	uint8_t* p = body;
+	*p++ = ncells;
+	for (console_small_uint_t i = 0; i < ncells; i += 1)
+		p = frame_put_cell(p, (console_uint_t)(c1 + i));
+	if (0 != hash) {
+		*p++ = (uint8_t)hash;
+		*p++ = (uint8_t)(hash >> 8);
+	}
+	return (size_t)(p - body);
+}
+
+// Send a frame & check the status & the output, which is any text followed by the reply.
+static char* check_frame(console_small_uint_t ncells, console_uint_t c1, uint16_t hash, console_rc_t rc_expected, const char* text, console_small_uint_t reply_depth, console_uint_t r1) {
+	static uint8_t seq;
+	uint8_t body[20], frame[30];
+	const size_t n = frame_make(frame, body, frame_body(body, ncells, c1, hash), ++seq);
+	mu_assert_equal_int(frame_send(frame, n), rc_expected);
+	mu_assert_equal_int(console_u_depth(), 0);
+	return check_frame_reply(text, seq, rc_expected, reply_depth, r1);
+}
+
+// A frame too big for the buffer is skipped, and one that is the wrong length for its cells is an error.
+static char* check_frame_accept(void) {
+	uint8_t body[2] = { 1, 0 }, frame[10];
+	const size_t n = frame_make(frame, body, 1, 1);				// One cell but no room for it.
+	mu_assert_equal_int(frame_send(frame, n), CONSOLE_RC_ERR_BAD_FRAME);
+	char* e = check_frame_reply("", 1, CONSOLE_RC_ERR_BAD_FRAME, 0, 0);
+	if (e) return e;
+
+	mu_assert_equal_int(consoleAccept(CONSOLE_BINARY_FRAME_CHAR), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAccept((char)(CONSOLE_INPUT_BUFFER_SIZE + 1)), CONSOLE_RC_STAT_ACC_PEND);
+#ifdef CONSOLE_FRAME_CRC
+	mu_assert_equal_int(consoleAccept((char)~(CONSOLE_INPUT_BUFFER_SIZE + 1)), CONSOLE_RC_STAT_ACC_PEND);
+#endif
+	for (int i = 0; i < CONSOLE_INPUT_BUFFER_SIZE; i += 1)
+		mu_assert_equal_int(consoleAccept(CONSOLE_INPUT_NEWLINE_CHAR), CONSOLE_RC_STAT_ACC_PEND);	// Any byte may be in a frame.
+	mu_assert_equal_int(consoleAccept('x'), CONSOLE_RC_ERR_ACC_OVF);
+	mu_assert_equal_int(consoleAccept('2'), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAccept(CONSOLE_INPUT_NEWLINE_CHAR), CONSOLE_RC_OK);
+	mu_assert_equal_str(consoleAcceptBuffer(), "2");
+	return NULL;
+}
+
+#ifdef CONSOLE_FRAME_CRC
+/* A frame with a bad CRC is not run, a bad length drops input up to the next frame char, which may be part way through a line, or newline, & a 
+	frame that is sent again is answered from the replay cache without running it again, but not a new frame with the same sequence number. 
+	Replies to bad frames are not cached. */
+static char* check_frame_crc(void) {
+	uint8_t body[20], frame[30];
+	char* e;
+	size_t n = frame_make(frame, body, frame_body(body, 1, 5, 0xb58b), 9);		// `5 .'
+	mu_assert_equal_int(frame_send(frame, n), CONSOLE_RC_OK);
+	if ((e = check_frame_reply("5 ", 9, CONSOLE_RC_OK, 0, 0))) return e;
+	mu_assert_equal_int(frame_send(frame, n), CONSOLE_RC_OK);				// Sent again, no output.
+	if ((e = check_frame_reply("", 9, CONSOLE_RC_OK, 0, 0))) return e;
+#ifdef CONSOLE_FRAME_REPLAY
+	n = frame_make(frame, body, frame_body(body, 1, 7, 0xb58b), 9);			// `7 .' reusing the number is run.
+	mu_assert_equal_int(frame_send(frame, n), CONSOLE_RC_OK);
+	if ((e = check_frame_reply("7 ", 9, CONSOLE_RC_OK, 0, 0))) return e;
+	const uint8_t short_frame[] = { CONSOLE_BINARY_FRAME_CHAR, 2, (uint8_t)~2U, 9, 0 };		// Too short, its reply is not kept.
+	for (console_small_uint_t i = 0; i < CONSOLE_FRAME_REPLAY; i += 1) {
+		mu_assert_equal_int(frame_send(short_frame, sizeof(short_frame)), CONSOLE_RC_ERR_BAD_FRAME);
+		if ((e = check_frame_reply("", 9, CONSOLE_RC_ERR_BAD_FRAME, 0, 0))) return e;
+	}
+	mu_assert_equal_int(frame_send(frame, n), CONSOLE_RC_OK);				// Still answered from the cache.
+	if ((e = check_frame_reply("", 9, CONSOLE_RC_OK, 0, 0))) return e;
+#endif
+
+	n = frame_make(frame, body, frame_body(body, 1, 6, 0xb58b), 10);
+	frame[n - 1] ^= 0x10;
+	mu_assert_equal_int(frame_send(frame, n), CONSOLE_RC_ERR_BAD_CRC);
+	if ((e = check_frame_reply("", 10, CONSOLE_RC_ERR_BAD_CRC, 0, 0))) return e;
+
+	frame[n - 1] ^= 0x10;
+	const char bad_len[] = { CONSOLE_BINARY_FRAME_CHAR, 5, 5, 'x', '1' };		// Bad length, so all is dropped.
+	for (size_t i = 0; i < sizeof(bad_len); i += 1)
+		mu_assert_equal_int(consoleAccept(bad_len[i]), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(frame_send(frame, n), CONSOLE_RC_OK);
+	if ((e = check_frame_reply("6 ", 10, CONSOLE_RC_OK, 0, 0))) return e;
+
+	for (size_t i = 0; i < sizeof(bad_len); i += 1)							// Dropped up to a newline, so a typed line is accepted.
+		mu_assert_equal_int(consoleAccept(bad_len[i]), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAccept(CONSOLE_INPUT_NEWLINE_CHAR), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAccept('2'), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAccept(CONSOLE_INPUT_NEWLINE_CHAR), CONSOLE_RC_OK);
+	mu_assert_equal_str(consoleAcceptBuffer(), "2");
+	return NULL;
+}
+#endif // CONSOLE_FRAME_CRC
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+// A frame fed from the ISR is taken as binary, so bytes like the abort & newline chars are data, & is returned by consoleAcceptLine().
+static char* check_frame_isr(void) {
+	uint8_t body[20], frame[30];
+	char* line;
+	const size_t n = frame_make(frame, body, frame_body(body, 1, 0x0d03, 0), '\n');
+	for (size_t i = 0; i < n; i += 1)
+		mu_assert_equal_int(consoleAcceptIsr((char)frame[i]), true);
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_STAT_ACC_FRAME);
+	mu_assert_equal_int(consoleProcessFrame(line), CONSOLE_RC_OK);
+	char* e = check_frame_reply("", '\n', CONSOLE_RC_OK, 1, 0x0d03);
+	if (e) return e;
+	mu_assert_equal_int(console_u_depth(), 0);
+
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_STAT_ACC_PEND);	// Releases the frame.
+	mu_assert_equal_int(consoleAcceptIsr('2'), false);						// Text after it is a line as usual.
+	mu_assert_equal_int(consoleAcceptIsr(CONSOLE_INPUT_NEWLINE_CHAR), false);
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_OK);
+	mu_assert_equal_str(line, "2");
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_STAT_ACC_PEND);
+	return NULL;
+}
+#endif
+#endif // CONSOLE_BINARY_FRAME_CHAR
+
+#ifdef CONSOLE_BULK_ACK_CHAR
+static uint8_t f_bulk_buf[CONSOLE_BULK_CHUNK_SIZE * 3];
+static size_t f_bulk_n, f_bulk_calls;
+static void bulk_sink(const uint8_t* buf, console_small_uint_t n) {
+	memcpy(&f_bulk_buf[f_bulk_n], buf, n);
+	f_bulk_n += n;
+	f_bulk_calls += 1;
+}
+
+// An upload takes any bytes after its line & passes them to the sink a buffer full at a time, each acked, then lines are taken as before.
+static char* check_upload(void) {
+	char inbuf[20];
+	const size_t n = CONSOLE_INPUT_BUFFER_SIZE * 2 + 5;
+
+	consoleSetBulkSink(NULL);
+	strcpy(inbuf, "1 UPLOAD");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_ERR_BAD_IDX);
+	consoleSetBulkSink(bulk_sink);
+	f_bulk_n = f_bulk_calls = 0;
+	sprintf(inbuf, "%u UPLOAD", (unsigned)n);
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	for (size_t i = 0; i < n; i += 1)
+		mu_assert_equal_int(consoleAccept((char)(i * 7U)), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(f_bulk_calls, 3);
+	mu_assert_equal_int(f_bulk_n, n);
+	for (size_t i = 0; i < n; i += 1)
+		mu_assert_equal_int(f_bulk_buf[i], (uint8_t)(i * 7U));
+	mu_assert_equal_str(print_output_get(), "\x06\x06\x06\x06");					// Ready, then one for each chunk.
+
+	mu_assert_equal_int(consoleAccept('1'), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAccept(CONSOLE_INPUT_NEWLINE_CHAR), CONSOLE_RC_OK);
+	mu_assert_equal_str(consoleAcceptBuffer(), "1");
+	return NULL;
+}
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+/* From the ISR the upload starts when the line is released, & bytes such as the abort, newline & frame chars are taken raw, in chunks larger 
+	than the input buffer. */
+static char* check_upload_isr(void) {
+	static const char data[] = "\x03\r\n\x02";
+	const size_t n = CONSOLE_BULK_CHUNK_SIZE * 2 + 5;
+	char text[20], *line;
+
+	print_output_init();
+	f_bulk_n = f_bulk_calls = 0;
+	sprintf(text, "%u UPLOAD\r", (unsigned)n);
+	accept_isr_str(text);
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_OK);
+	mu_assert_equal_int(consoleProcess(line, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_str(print_output_get(), "");								// Not ready until the line is released.
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_str(print_output_get(), "\x06");
+	for (size_t i = 0; i < n; i += 1) {
+		mu_assert_equal_int(consoleAcceptIsr(data[i % 4]), true);
+		if (((i + 1) % CONSOLE_BULK_CHUNK_SIZE == 0) || (i + 1 == n))			// Host waits for the ack after each chunk.
+			mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_STAT_ACC_PEND);
+	}
+	mu_assert_equal_int(f_bulk_calls, 3);
+	mu_assert_equal_int(f_bulk_n, n);
+	for (size_t i = 0; i < n; i += 1)
+		mu_assert_equal_int(f_bulk_buf[i], (uint8_t)data[i % 4]);
+	mu_assert_equal_str(print_output_get(), "\x06\x06\x06\x06");
+
+	mu_assert_equal_int(consoleAcceptIsr('1'), false);							// Text again after it.
+	mu_assert_equal_int(consoleAcceptIsr(CONSOLE_INPUT_NEWLINE_CHAR), false);
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_OK);
+	mu_assert_equal_str(line, "1");
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_STAT_ACC_PEND);
+	return NULL;
+}
+#endif
+
+#endif // CONSOLE_BULK_ACK_CHAR
+
+#ifdef CONSOLE_WANT_DUMP
+// Dump prints lines of the address & 16 hex bytes, only the step of the address of a string is known. Binary is written raw.
+static char* check_dump(void) {
+	char inbuf[40], out[sizeof(print_output_buf)];
+	const int digits = CONSOLE_CELL_SIZE * 2;
+
+	strcpy(inbuf, "\"0123456789ABCDEFgh 18 DUMP");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	strcpy(out, print_output_get());
+	char* const line2 = strchr(&out[1], '\n');
+	mu_assert_equal_int(line2 - out, 2 + digits + 16 * 3);
+	mu_assert_equal_int(strtoull(&line2[2], NULL, 16) - strtoull(&out[2], NULL, 16), 16);
+	memset(&out[2], 'x', (size_t)digits);
+	memset(&line2[2], 'x', (size_t)digits);
+	char exp[sizeof(out)];
+	sprintf(exp, "\n$%.*s 30 31 32 33 34 35 36 37 38 39 41 42 43 44 45 46\n$%.*s 67 68", digits, "xxxxxxxxxxxxxxxx", digits, "xxxxxxxxxxxxxxxx");
+	mu_assert_equal_str(out, exp);
+
+	print_output_init();
+	strcpy(inbuf, "\"AB 3 DUMP-B \"CD 2 DUMP-PB \"EF 0 DUMP");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	print_output_get();
+	mu_assert_equal_int(print_output_p - print_output_buf, 5);
+	mu_assert_equal_int(memcmp(print_output_buf, "AB\0CD", 5), 0);
+	mu_assert_equal_int(console_u_depth(), 0);
+	return NULL;
+}
+#endif // CONSOLE_WANT_DUMP
+
+#ifdef CONSOLE_TASKS
+// Tasks run when due with their own stack & tagged output, leaving the console's stack alone.
+static char* check_tasks(void) {
+	char inbuf[40];
+
+	consoleServiceTasks(1000);
+	strcpy(inbuf, "100 EVERY 1");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	strcpy(inbuf, "50 AFTER  2 .");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_int(console_u_depth(), 2);
+	mu_assert_equal_int(consoleTasksWait(1000), 50);
+	mu_assert_equal_int(consoleServiceTasks(1049), 0);
+	mu_assert_equal_int(consoleServiceTasks(1050), 1);
+	mu_assert_equal_str(print_output_get(), "[2] 2 \n");
+	mu_assert_equal_int(consoleTasksWait(1050), 50);
+	mu_assert_equal_int(consoleServiceTasks(1100), 1);		// Task 1 leaves 1 on its stack.
+	mu_assert_equal_int(consoleServiceTasks(1350), 1);		// Late, so the run at 1300 is skipped.
+	mu_assert_equal_int(consoleTasksWait(1350), 100);
+	mu_assert_equal_int(consoleServiceTasks(1450), 1);		// Now too much for its stack.
+	mu_assert_equal_str(print_output_get(), "[2] 2 \n[1] \n[1] \n[1] stack overflow \n");
+	mu_assert_equal_int(consoleTasksWait(1450), CONSOLE_TASKS_IDLE);
+	mu_assert_equal_int(console_u_pop(), 2);
+	mu_assert_equal_int(console_u_pop(), 1);
+
+	print_output_init();
+	strcpy(inbuf, "10 EVERY 1");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	strcpy(inbuf, "TASKS");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_str(print_output_get(), "\n1 10 1");
+	strcpy(inbuf, "10 EVERY 1234567890123456");			// Too long.
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_ERR_MEM_OVF);
+	strcpy(inbuf, "KILL 1 KILL");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_ERR_BAD_IDX);
+	mu_assert_equal_int(consoleTasksWait(0), CONSOLE_TASKS_IDLE);
+	return NULL;
+}
+#endif // CONSOLE_TASKS
+
+#ifdef CONSOLE_MULTI_CONTEXT
+// Each console has its own stack & accept buffer.
+static char* check_multi_context(void) {
+	static console_t con1, con2;
+	console_t* const saved = consoleGetContext();
+	char inbuf[20];
+
+	consoleInitContext(&con1, NULL);
+	consoleInitContext(&con2, &con1);
+	strcpy(inbuf, "1 2");
+	mu_assert_equal_int(consoleProcessContext(&con1, inbuf, NULL), CONSOLE_RC_OK);
+	strcpy(inbuf, "3");
+	mu_assert_equal_int(consoleProcessContext(&con2, inbuf, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_int(console_u_depth(), 1);
+	mu_assert_equal_int(consoleGetContext()->user == &con1, true);
+	strcpy(inbuf, "DROP DROP");
+	mu_assert_equal_int(consoleProcess(inbuf, NULL), CONSOLE_RC_ERR_DSTK_UNF);
+	consoleSetContext(&con1);
+	mu_assert_equal_int(console_u_depth(), 2);
+	mu_assert_equal_int(console_u_tos(), 2);
+
+	mu_assert_equal_int(consoleAcceptContext(&con1, 'a'), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAcceptContext(&con2, 'b'), CONSOLE_RC_STAT_ACC_PEND);
+	mu_assert_equal_int(consoleAcceptContext(&con1, CONSOLE_INPUT_NEWLINE_CHAR), CONSOLE_RC_OK);
+	mu_assert_equal_str(consoleAcceptBuffer(), "a");
+	mu_assert_equal_int(consoleAcceptContext(&con2, CONSOLE_INPUT_NEWLINE_CHAR), CONSOLE_RC_OK);
+	mu_assert_equal_str(consoleAcceptBuffer(), "b");
+
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+	char* line;
+	mu_assert_equal_int(consoleAcceptIsrContext(&con1, 'c'), false);			// Each console has its own pair of line buffers.
+	mu_assert_equal_int(consoleAcceptIsrContext(&con2, 'd'), false);
+	mu_assert_equal_int(consoleAcceptIsrContext(&con2, CONSOLE_INPUT_NEWLINE_CHAR), false);
+	mu_assert_equal_int(consoleAcceptIsrContext(&con1, CONSOLE_INPUT_NEWLINE_CHAR), false);
+	consoleSetContext(&con2);
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_OK);
+	mu_assert_equal_str(line, "d");
+	consoleSetContext(&con1);
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_OK);
+	mu_assert_equal_str(line, "c");
+	mu_assert_equal_int(consoleAcceptLine(&line), CONSOLE_RC_STAT_ACC_PEND);
+#endif
+#ifdef CONSOLE_BULK_ACK_CHAR
+	consoleSetBulkSink(bulk_sink);												// And its own bulk sink.
+	strcpy(inbuf, "1 UPLOAD");
+	mu_assert_equal_int(consoleProcessContext(&con2, inbuf, NULL), CONSOLE_RC_ERR_BAD_IDX);
+#endif
+
+	consoleSetContext(saved);
+	return NULL;
+}
+
+#ifdef CONSOLE_MULTITASK
+// Tasks take turns, giving way at PAUSE or at the end of a line, each with its own stack.
+static char* check_multitask(void) {
+	console_tcb_t *a, *b, *t;
+	a = consoleMultitaskSpawn("1 . PAUSE 2 .\n5 3 .", false, NULL);
+	b = consoleMultitaskSpawn("7 .", true, NULL);
+	mu_assert_equal_int(NULL != a, true);
+	mu_assert_equal_int(NULL != b, true);
+	mu_assert_equal_int(NULL == consoleMultitaskSpawn("", false, NULL), true);	// All in use.
+
+	mu_assert_equal_int(consoleMultitaskRun(&t, NULL), CONSOLE_RC_STAT_PROC_PEND);
+	mu_assert_equal_int(t == a, true);
+	mu_assert_equal_int(consoleMultitaskRun(&t, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_int(t == b, true);
+	for (int i = 0; i < 5; i += 1)
+		mu_assert_equal_int(consoleMultitaskRun(&t, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_int(t == b, true);							// Task a has finished.
+	mu_assert_equal_str(print_output_get(), "1 7 2 7 3 7 7 ");
+	mu_assert_equal_int(a->con.ctx.sp[0], 5);					// Left on a's own stack.
+	mu_assert_equal_int(console_u_depth(), 0);
+
+	consoleMultitaskStop(b);
+	mu_assert_equal_int(consoleMultitaskRun(&t, NULL), CONSOLE_RC_OK);
+	mu_assert_equal_int(NULL == t, true);
+	return NULL;
+}
+#endif // CONSOLE_MULTITASK
+#endif // CONSOLE_MULTI_CONTEXT
+
 int main(int argc, char **argv) {
 	(void)argc; (void)argv;
-	printf(CONSOLE_PSTR("Console Unit Tests: %u bit.\n"), (unsigned)(8 * sizeof(console_int_t)));
+	printf(CONSOLE_PSTR("Console Unit Tests: %u bit, %u bit pointers.\n"), (unsigned)(8 * sizeof(console_int_t)), (unsigned)(8 * sizeof(void*)));
+#ifdef CONSOLE_MULTITASK
+	printf("Multitask: %u tasks of %u bytes.\n", (unsigned)CONSOLE_MULTITASK, (unsigned)sizeof(console_tcb_t));
+#endif
 
 	mu_init();
 
@@ -200,18 +816,27 @@ int main(int argc, char **argv) {
 	mu_run_test(check_print(CONSOLE_PRINT_HEX2|CONSOLE_PRINT_NO_LEAD,	0x1234, 				"34 "));
 
 	// Stringz
-	mu_run_test(check_print(CONSOLE_PRINT_STR, (console_int_t)"hello", "hello "));
-	mu_run_test(check_print(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, (console_int_t)"hello", "hello"));
-	mu_run_test(check_print(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_LEAD, (console_int_t)"hello", "hello ")); // Ignored.
-	mu_run_test(check_print(CONSOLE_PRINT_STR_P, (console_int_t)CONSOLE_PSTR("hello"), "hello "));
-	mu_run_test(check_print(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, (console_int_t)CONSOLE_PSTR("hello"), "hello"));
-	mu_run_test(check_print(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_LEAD, (console_int_t)CONSOLE_PSTR("hello"), "hello ")); // Ignored.
+	mu_run_test(check_print(CONSOLE_PRINT_STR, console_ptr_arg("hello"), "hello "));
+	mu_run_test(check_print(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_SEP, console_ptr_arg("hello"), "hello"));
+	mu_run_test(check_print(CONSOLE_PRINT_STR|CONSOLE_PRINT_NO_LEAD, console_ptr_arg("hello"), "hello ")); // Ignored.
+	mu_run_test(check_print(CONSOLE_PRINT_STR_P, console_ptr_arg(CONSOLE_PSTR("hello")), "hello "));
+	mu_run_test(check_print(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_SEP, console_ptr_arg(CONSOLE_PSTR("hello")), "hello"));
+	mu_run_test(check_print(CONSOLE_PRINT_STR_P|CONSOLE_PRINT_NO_LEAD, console_ptr_arg(CONSOLE_PSTR("hello")), "hello ")); // Ignored.
 
  	mu_run_test(check_print(CONSOLE_PRINT_CHAR, 'x', "x "));
  	mu_run_test(check_print(CONSOLE_PRINT_CHAR|CONSOLE_PRINT_NO_SEP, 'x', "x"));
 
 	mu_run_test(check_print(CONSOLE_PRINT_NEWLINE|CONSOLE_PRINT_NO_SEP,		1235, "\n"));  // NO_SEP has no effect.
 	mu_run_test(check_print((CONSOLE_PRINT_NO_SEP-1)|CONSOLE_PRINT_NO_SEP,	1235, ""));		// No output for bad format..
+	mu_run_test(check_print(CONSOLE_PRINT_SIGNED,						-9,				"-9 "));
+	mu_run_test(check_print(CONSOLE_PRINT_SIGNED,						99,				"99 "));
+	mu_run_test(check_print(CONSOLE_PRINT_SIGNED,						-100,			"-100 "));
+	mu_run_test(check_print(CONSOLE_PRINT_UNSIGNED,						1009,			"+1009 "));
+	mu_run_test(check_print(CONSOLE_PRINT_HEX2,							0x0f,			"$0F "));
+	mu_run_test(check_print_vs_printf());
+#ifdef CONSOLE_OUTPUT_BUFFER_SIZE
+	mu_run_test(check_print_buffered());
+#endif
 
 	// Test console...
 	mu_run_test(check_console("", "",						CONSOLE_RC_OK,				0));
@@ -229,21 +854,21 @@ int main(int argc, char **argv) {
 	mu_run_test(check_console("1a", "",						CONSOLE_RC_ERR_BAD_CMD, 0));		// Flagged as unknown command, even though it's really a bad base. We could have a command `1a'.
 
 	if (sizeof(console_int_t) == 2) {
-		mu_run_test(check_console("32767", "",				CONSOLE_RC_OK,				1, 32767));
-		mu_run_test(check_console("-32768", "",				CONSOLE_RC_OK,				1, -32768));
+		mu_run_test(check_console("32767", "",				CONSOLE_RC_OK,				1, (console_int_t)32767));
+		mu_run_test(check_console("-32768", "",				CONSOLE_RC_OK,				1, (console_int_t)-32768));
 		mu_run_test(check_console("32768", "",				CONSOLE_RC_ERR_NUM_OVF,	0));
 		mu_run_test(check_console("-32769", "",				CONSOLE_RC_ERR_NUM_OVF,	0));
-		mu_run_test(check_console("+32768", "",				CONSOLE_RC_OK,				1, 32768));
-		mu_run_test(check_console("+65535", "",				CONSOLE_RC_OK,				1, 65535));
+		mu_run_test(check_console("+32768", "",				CONSOLE_RC_OK,				1, (console_int_t)32768));
+		mu_run_test(check_console("+65535", "",				CONSOLE_RC_OK,				1, (console_int_t)65535));
 		mu_run_test(check_console("+65536", "",				CONSOLE_RC_ERR_NUM_OVF,	0));
 	}
 	else if (sizeof(console_int_t) == 4) {
-		mu_run_test(check_console("2147483647", "",			CONSOLE_RC_OK,				1, 2147483647L));
-		mu_run_test(check_console("-2147483648", "",		CONSOLE_RC_OK,				1, -2147483648L));
+		mu_run_test(check_console("2147483647", "",			CONSOLE_RC_OK,				1, (console_int_t)2147483647L));
+		mu_run_test(check_console("-2147483648", "",		CONSOLE_RC_OK,				1, (console_int_t)-2147483648L));
 		mu_run_test(check_console("2147483648", "",			CONSOLE_RC_ERR_NUM_OVF,	0));
 		mu_run_test(check_console("-2147483649", "",		CONSOLE_RC_ERR_NUM_OVF,	0));
-		mu_run_test(check_console("+2147483647", "",		CONSOLE_RC_OK,				1, 2147483647L));
-		mu_run_test(check_console("+4294967295", "",		CONSOLE_RC_OK,				1, 4294967295));
+		mu_run_test(check_console("+2147483647", "",		CONSOLE_RC_OK,				1, (console_int_t)2147483647L));
+		mu_run_test(check_console("+4294967295", "",		CONSOLE_RC_OK,				1, (console_int_t)4294967295));
 		mu_run_test(check_console("+4294967296", "",		CONSOLE_RC_ERR_NUM_OVF,	0));
 	}
 	else if (sizeof(console_int_t) == 8) {
@@ -263,12 +888,12 @@ int main(int argc, char **argv) {
 	mu_run_test(check_console("$", "",						CONSOLE_RC_ERR_BAD_CMD,	0));
 	mu_run_test(check_console("$1", "",						CONSOLE_RC_OK,				1, (console_int_t)1));
 	if (sizeof(console_int_t) == 2) {
-		mu_run_test(check_console("$FFFF", "",				CONSOLE_RC_OK,				1, 0xffff));
+		mu_run_test(check_console("$FFFF", "",				CONSOLE_RC_OK,				1, (console_int_t)0xffff));
 		mu_run_test(check_console("$10000", "",				CONSOLE_RC_ERR_NUM_OVF,	0));
 		mu_run_test(check_console("$FFFFF", "",				CONSOLE_RC_ERR_NUM_OVF,	0));
 	}
 	else if (sizeof(console_int_t) == 4) {
-		mu_run_test(check_console("$FFFFFFFF", "",			CONSOLE_RC_OK,				1, 0xffffffff));
+		mu_run_test(check_console("$FFFFFFFF", "",			CONSOLE_RC_OK,				1, (console_int_t)0xffffffff));
 		mu_run_test(check_console("$100000000", "",			CONSOLE_RC_ERR_NUM_OVF,	0));
 		mu_run_test(check_console("$FFFFFFFFF", "",			CONSOLE_RC_ERR_NUM_OVF,	0));
 	}
@@ -297,9 +922,35 @@ int main(int argc, char **argv) {
 	mu_run_test(check_hex_string("&1a", 1, 0x1a));
 	mu_run_test(check_hex_string("&1a00", 2, 0x1a, 0x00));
 
+#ifdef CONSOLE_ADDRESS_HANDLES
+	// Addresses held as handles as a cell cannot hold a pointer.
+	mu_run_test(check_console("\"a \"b .\" .\"", "b a ",	CONSOLE_RC_OK,				0));
+	mu_run_test(check_console("\"a 2 .\"", "",			CONSOLE_RC_ERR_BAD_IDX,		1, (console_int_t)1));
+	mu_run_test(check_console("\"1 DROP \"2 DROP \"3 DROP \"4 DROP \"5 DROP \"6 DROP \"7 DROP \"8 DROP \"9", "", CONSOLE_RC_ERR_ADDR_OVF, 0));
+#endif
+
+#ifdef CONSOLE_SCRATCH_SIZE
+	// Scratch arena for strings.
+	mu_run_test(check_console("\"abcdefghijklmnopqrstuvwxyz0123456 .\"", "", CONSOLE_RC_ERR_MEM_OVF, 0));	// Too big for arena.
+	mu_run_test(check_console("\"abcdefghijklmnopqrstuvwxyz01234 .\"", "abcdefghijklmnopqrstuvwxyz01234 ", CONSOLE_RC_OK, 0));
+	mu_run_test(check_console("\"abcdefghijklmnop DROP \"abcdefghijklmnop", "", CONSOLE_RC_ERR_MEM_OVF, 0));
+	mu_run_test(check_console("&1g \"abcdefghijklmnopqrstuvwxyz01234 .\"", "", CONSOLE_RC_ERR_BAD_CMD, 0));	// Bad hex string frees arena.
+#endif
+
+#ifdef CONSOLE_STRING_HEAP_SIZE
+	// String heap.
+	mu_run_test(check_keep("\"hello KEEP", ".\"", CONSOLE_RC_OK, "hello "));
+	mu_run_test(check_ckeep());
+	mu_run_test(check_keep("\"abcdefgh KEEP \"abcdef KEEP", ".\" .\"", CONSOLE_RC_OK, "abcdef abcdefgh "));
+	mu_run_test(check_keep("\"abcdefgh KEEP", "\"abcdefgh KEEP", CONSOLE_RC_ERR_MEM_OVF, ""));
+	mu_run_test(check_keep("\"abcdefgh KEEP KEEP-CLEAR \"abcdefgh KEEP", ".\"", CONSOLE_RC_OK, "abcdefgh "));
+#endif
+
 	// Number printing.
 	mu_run_test(check_console(".", "",						CONSOLE_RC_ERR_DSTK_UNF,	0));
 	mu_run_test(check_console("0 .", "0 ",					CONSOLE_RC_OK,				0));
+	mu_run_test(check_console("11 22 . . \"xyz 33 . .\" 4 .", "22 11 33 xyz 4 ",	CONSOLE_RC_OK,	0));	// Output over consumed input.
+	mu_run_test(check_console("\"abc 12345 . .\"", "12345 abc ",	CONSOLE_RC_OK,				0));	// Output not over string.
 	mu_run_test(check_console("U.", "",						CONSOLE_RC_ERR_DSTK_UNF,	0));
 	mu_run_test(check_console("0 U.", "+0 ",				CONSOLE_RC_OK,				0));
 	mu_run_test(check_console("$.", "",						CONSOLE_RC_ERR_DSTK_UNF,	0));
@@ -384,12 +1035,12 @@ int main(int argc, char **argv) {
 	mu_run_test(check_console("U/", "",						CONSOLE_RC_ERR_DSTK_UNF,	0));
 	if (sizeof(console_int_t) == 2)
 		mu_run_test(check_console("$fffe 16 U/", "",		CONSOLE_RC_OK,				1, (console_int_t)0xfff));
-	if (sizeof(console_int_t) == 4)
+	else if (sizeof(console_int_t) == 4)
 		mu_run_test(check_console("$fffffffe 16 U/", "",	CONSOLE_RC_OK,				1, (console_int_t)0xfffffff));
-	if (sizeof(console_int_t) == 8)
+	else if (sizeof(console_int_t) == 8)
 		mu_run_test(check_console("$fffffffffffffffe 16 U/", "", CONSOLE_RC_OK,			1, (console_int_t)0xfffffffffffffff));
 	else
-		mu_run_test("console_int_t not 16 or 32 bit!");
+		mu_run_test("console_int_t not 16, 32 or 64 bit!");
 	mu_run_test(check_console("123 0 U/", "",				CONSOLE_RC_ERR_DIV_ZERO,	1, (console_int_t)123));
 	mu_run_test(check_console("0 0 U/", "",					CONSOLE_RC_ERR_DIV_ZERO,	1, (console_int_t)0));
 
@@ -409,6 +1060,51 @@ int main(int argc, char **argv) {
 	mu_run_test(check_accept_non_printable());
 	mu_run_test(check_accept_line_cancel(false));
 	mu_run_test(check_accept_line_cancel(true));
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+	mu_run_test(check_accept_double_buffer());
+#endif
+#ifdef CONSOLE_QUEUE_SIZE
+	mu_run_test(check_queue());
+#endif
+#ifdef CONSOLE_PROCESS_STEP
+	mu_run_test(check_process_step());
+	mu_run_test(check_yield());
+#endif
+#ifdef CONSOLE_INPUT_ABORT_CHAR
+	mu_run_test(check_abort());
+#endif
+#ifdef CONSOLE_BINARY_FRAME_CHAR
+	mu_run_test(check_frame(2, 1, 0xb58e, CONSOLE_RC_OK, "", 1, 3));				// `1 2 +'
+	mu_run_test(check_frame(1, 5, 0xb58b, CONSOLE_RC_OK, "5 ", 0, 0));			// `5 .', text output comes first.
+	mu_run_test(check_frame(1, 7, 0, CONSOLE_RC_OK, "", 1, 7));					// No command, just push.
+	mu_run_test(check_frame(0, 0, 0xb58b, CONSOLE_RC_ERR_DSTK_UNF, "", 0, 0));
+	mu_run_test(check_frame(0, 0, 0x1234, CONSOLE_RC_ERR_BAD_CMD, "", 0, 0));
+	mu_run_test(check_frame_accept());
+#ifdef CONSOLE_FRAME_CRC
+	mu_run_test(check_frame_crc());
+#endif
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+	mu_run_test(check_frame_isr());
+#endif
+#endif
+#ifdef CONSOLE_BULK_ACK_CHAR
+	mu_run_test(check_upload());
+#ifdef CONSOLE_ACCEPT_DOUBLE_BUFFER
+	mu_run_test(check_upload_isr());
+#endif
+#endif
+#ifdef CONSOLE_WANT_DUMP
+	mu_run_test(check_dump());
+#endif
+#ifdef CONSOLE_TASKS
+	mu_run_test(check_tasks());
+#endif
+#ifdef CONSOLE_MULTI_CONTEXT
+	mu_run_test(check_multi_context());
+#endif
+#ifdef CONSOLE_MULTITASK
+	mu_run_test(check_multitask());
+#endif
 
 	mu_print_summary();
 
@@ -0,0 +1,104 @@
+/* Stress test for the lock-free queue, built with ThreadSanitizer by `make tsan'. A producer thread writes numbered lines to the input queue,
+	the console thread runs them with consoleServiceQueue() & its output goes through an output queue, which the main thread reads & checks. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "console.h"
+
+#define STRESS_LINES 100000
+
+static console_queue_t f_in, f_out;
+
+// Output from the console thread, waits for room in the output queue.
+void console_output_write(const char* buf, size_t n) {
+	while (n > 0) {
+		const size_t nw = consoleQueueWrite(&f_out, buf, n);
+		if (0 == nw)
+			sched_yield();
+		buf += nw;
+		n -= nw;
+	}
+}
+
+static void* producer(void* arg) {
+	(void)arg;
+	for (unsigned i = 0; i < STRESS_LINES; i += 1) {
+		char line[16];
+		const int len = snprintf(line, sizeof(line), "%u .\r", i);
+		const char* p = line;
+		size_t n = (size_t)len;
+		while (n > 0) {
+			const size_t nw = consoleQueueWrite(&f_in, p, n);
+			if (0 == nw)
+				sched_yield();
+			p += nw;
+			n -= nw;
+		}
+	}
+	return NULL;
+}
+
+static void* console_thread(void* arg) {
+	(void)arg;
+	unsigned lines = 0;
+	while (lines < STRESS_LINES) {
+		const console_rc_t rc = consoleServiceQueue(&f_in, NULL);
+		if (CONSOLE_RC_STAT_ACC_PEND == rc) {
+			sched_yield();
+			continue;
+		}
+		if (CONSOLE_RC_OK != rc)
+			consolePrint(CONSOLE_PRINT_STR_P, console_ptr_arg("error"));
+		consolePrint(CONSOLE_PRINT_NEWLINE, 0);
+		lines += 1;
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	(void)argc; (void)argv;
+	consoleInit();
+	consoleQueueInit(&f_in);
+	consoleQueueInit(&f_out);
+
+	pthread_t tp, tc;
+	if ((0 != pthread_create(&tp, NULL, producer, NULL)) || (0 != pthread_create(&tc, NULL, console_thread, NULL))) {
+		perror("pthread_create");
+		return 1;
+	}
+
+	// Each line's output must be its number, in order.
+	unsigned expected = 0, errors = 0;
+	char line[32];
+	size_t len = 0;
+	while (expected < STRESS_LINES) {
+		char c;
+		if (0 == consoleQueueRead(&f_out, &c, 1)) {
+			sched_yield();
+			continue;
+		}
+		if ('\n' != c) {
+			if (len < sizeof(line) - 1)
+				line[len++] = c;
+			continue;
+		}
+		line[len] = '\0';
+		len = 0;
+		char want[32];
+		snprintf(want, sizeof(want), "%u ", expected);
+		if (0 != strcmp(line, want)) {
+			if (errors++ < 10)
+				printf("Line %u: expected `%s', got `%s'.\n", expected, want, line);
+		}
+		expected += 1;
+	}
+	pthread_join(tp, NULL);
+	pthread_join(tc, NULL);
+	printf("Queue stress: %u lines, %u errors.\n", expected, errors);
+	return (0 == errors) ? 0 : 1;
+}